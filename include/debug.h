@@ -31,5 +31,6 @@ extern Bitu debugCallback;
 
 #ifdef C_HEAVY_DEBUG
 bool DEBUG_HeavyIsBreakpoint(void);
+void DEBUG_HeavyMemoryChanged(void);
 void DEBUG_HeavyWriteLogInstruction(void);
 #endif
@@ -209,6 +209,14 @@ void					DOSBOX_RunMachine();
 void					DOSBOX_SetLoop(LoopHandler * handler);
 void					DOSBOX_SetNormalLoop();
 
+/* -benchmark: run unpaced without drawing and count the work done */
+extern bool				benchmark_mode;
+extern unsigned long long	benchmark_instruction_limit;
+extern unsigned long long	benchmark_frames;
+void					DOSBOX_BenchmarkReset(void);
+unsigned long long		DOSBOX_BenchmarkInstructions(void);
+std::string				DOSBOX_BenchmarkReport(void);
+
 /* machine tests for use with if() statements */
 #define IS_TANDY_ARCH			((machine==MCH_TANDY) || (machine==MCH_PCJR))
 #define IS_EGAVGA_ARCH			((machine==MCH_EGA) || (machine==MCH_VGA))
@@ -88,4 +88,17 @@ class EthernetConnection
  */
 EthernetConnection* OpenEthernetConnection(std::string backendstr);
 
+/** Moves a virtual Ethernet connection onto its own thread.
+ * The returned connection polls the backend and sends packets from a network
+ * thread, so the backend is no longer limited to one poll per call from the
+ * emulator. Received packets wait in a queue until GetPackets is called,
+ * which passes them to the callback on the caller's thread. SendPacket only
+ * queues the packet. If a queue is full, the packet is dropped.
+ * The returned connection owns the backend and deletes it when deleted.
+ * If the thread cannot be started, the backend is returned unchanged.
+ * @param backend An initialized Ethernet connection
+ * @return A connection that passes packets to and from the backend
+ */
+EthernetConnection* OpenEthernetThread(EthernetConnection* backend);
+
 #endif
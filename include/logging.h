@@ -69,6 +69,8 @@ public:
 	static void EarlyInit();
 	static void Init();
 	static void Exit();
+	static void Flush();
+	static unsigned int Dropped(LOG_TYPES type);	/* dropped by the rate limit, LOG_ALL: dropped because the log queue was full */
 
 	void operator() (char const* format, ...) GCC_ATTRIBUTE(__format__(__printf__, 2, 3));  //../src/debug/debug_gui.cpp
 };
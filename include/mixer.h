@@ -60,8 +60,8 @@ public:
 	void EndFrame(Bitu samples);
 
 	void lowpassUpdate();
-	int32_t lowpassStep(int32_t in,const unsigned int iteration,const unsigned int channel);
 	void lowpassProc(int32_t ch[2]);
+	int32_t scaleDelta(const int32_t d,const unsigned int f) const;
 
 	template<class Type,bool stereo,bool signeddata,bool nativeorder,bool lowpass>
 	void loadCurrentSample(Bitu &len, const Type* &data);
@@ -101,8 +101,10 @@ public:
 	float volmain[2];
 	float scale[2];
 	int32_t volmul[2];
-	int32_t lowpass[LOWPASS_ORDER][2];	// lowpass filter
+	double lowpass[LOWPASS_ORDER][2];	// lowpass filter state, the last two outputs of each biquad section
 	int32_t lowpass_alpha;			// "alpha" multiplier for lowpass (16.16 fixed point)
+	double lowpass_biquad[3];		// two one-pole stages as one biquad section: a*a, 2*(1-a), (1-a)*(1-a)
+	double lowpass_pole[2];			// the one-pole stage left over from an odd order: a, 1-a
 	Bitu lowpass_freq;
 	unsigned int lowpass_order;
 	bool lowpass_on_load;			// apply lowpass on sample load (if source rate > mixer rate)
@@ -112,6 +114,7 @@ public:
 	unsigned int rendering_to_n,rendering_to_d;
 	unsigned int rend_n,rend_d;
 	unsigned int freq_n,freq_d,freq_d_orig;
+	double freq_d_inv;			// 1.0 / freq_d
 	bool current_loaded;
 	int32_t current[2],last[2],delta[2],max_change;
 	int32_t msbuffer[2048][2];		// more than enough for 1ms of audio, at mixer sample rate
@@ -123,7 +126,22 @@ public:
 	MixerChannel * next;
 };
 
+/* (int64_t)d * f / freq_d, rounded toward zero like the division, for f < freq_d.
+ * Multiplying by the reciprocal lands within one of the quotient and one
+ * check puts it right, which is a lot cheaper than a 64-bit divide. */
+inline int32_t MixerChannel::scaleDelta(const int32_t d,const unsigned int f) const {
+	if (d == 0) return 0;
+
+	const uint64_t num = (uint64_t)(d < 0 ? -(int64_t)d : (int64_t)d) * (uint64_t)f;
+	uint64_t q = (uint64_t)((double)num * freq_d_inv);
+	if (q * freq_d > num) q--;
+	else if ((q + 1) * freq_d <= num) q++;
+
+	return d < 0 ? (int32_t)(0 - (int64_t)q) : (int32_t)q;
+}
+
 void MIXER_SetMaster(float vol0,float vol1);
+void MIXER_ScaleClip(int16_t *out,const int32_t *in,Bitu frames,int32_t volscale1,int32_t volscale2);
 
 MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * name);
 MixerChannel * MIXER_FindChannel(const char * name);
@@ -111,6 +111,7 @@ typedef struct Render_t {
 	bool aspectOffload;
 	bool disablerender;
 	bool fullFrame;
+	bool frameCached;	// last frame went through the scaler cache from top to bottom
 	bool forceUpdate;
 	bool autofit;
 } Render_t;
@@ -188,6 +189,7 @@ extern ScalerLineHandler_t RENDER_DrawLine;
 void RENDER_SetSize(Bitu width,Bitu height,Bitu bpp,float fps,double scrn_ratio);
 bool RENDER_StartUpdate(void);
 void RENDER_EndUpdate(bool abort);
+bool RENDER_DrawLineUnchanged(void);
 void RENDER_SetPal(uint8_t entry,uint8_t red,uint8_t green,uint8_t blue);
 bool RENDER_GetForceUpdate(void);
 void RENDER_SetForceUpdate(bool);
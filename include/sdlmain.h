@@ -138,6 +138,7 @@ struct SDL_Block {
     struct {
         Bitu pitch;
         void * framebuf;
+        size_t framebuf_size;
         GameLink::sSharedMMapInput_R2 input_prev;
         GameLink::sSharedMMapInput_R2 input;
         GameLink::sSharedMMapAudio_R1 audio;
@@ -145,6 +146,7 @@ struct SDL_Block {
         bool enable;
         bool snoop;
         Bitu loadaddr;
+        int protocol;
     } gamelink;
 #endif // C_GAMELINK
     struct {
@@ -790,6 +790,49 @@ void VGA_SetOverride(bool vga_override);
 
 extern VGA_Type vga;
 
+/* VRAM dirty page tracking to skip scanlines that did not change, one bit per 4KB page.
+ * pages collects CPU/accelerator writes since the last frame the renderer accepted,
+ * pages_frame holds what was written the frame before that. A scanline is only skipped
+ * if its pages are clear in both and nothing invalidated the whole frame.
+ * Kept out of VGA_Draw so that save states are not affected. */
+struct VGA_DirtyPages {
+	uint8_t *pages = NULL;
+	uint8_t *pages_frame = NULL;
+	unsigned int size = 0;		// bytes per bitmap
+	unsigned int line_bytes = 0;	// bytes of VRAM read per scanline by VGA_DrawLine
+	unsigned int cursor_bpp = 0;	// bytes per pixel if VGA_DrawLine overlays the S3 hardware cursor, else 0
+	Bitu cursor_first = 1,cursor_last = 0;		// scanlines the hardware cursor covered last frame (none if first > last)
+	Bitu cursor_seen_first = 1,cursor_seen_last = 0;	// and so far this frame
+	unsigned int lines_converted = 0;	// scanlines converted from video memory so far this frame (statistics)
+	bool invalidate = true;		// palette/mode/etc. changed, convert every line next frame
+	bool skip = false;		// scanlines may be skipped this frame
+};
+
+extern VGA_DirtyPages vga_dirty;
+extern bool vga_dirty_tracking;
+
+/* mark the 4KB page holding VRAM byte offset ofs as written. This is called from the memory
+ * write paths, it must cost next to nothing when tracking is off. */
+static inline void VGA_DirtyMark(const uint32_t ofs) {
+	if (GCC_UNLIKELY(vga_dirty_tracking)) {
+		const uint32_t page = (ofs & vga.mem.memmask) >> 12u;
+		vga_dirty.pages[page >> 3u] |= (uint8_t)(1u << (page & 7u));
+	}
+}
+
+/* mark every 4KB page touched by len bytes starting at VRAM byte offset ofs as written */
+static inline void VGA_DirtyMarkRange(const uint32_t ofs,const uint32_t len) {
+	if (GCC_UNLIKELY(vga_dirty_tracking) && len != 0u) {
+		for (uint32_t p=ofs & ~0xFFFu;p < (ofs+len);p += 0x1000u)
+			VGA_DirtyMark(p);
+	}
+}
+
+/* something other than VRAM changed the picture (palette, mode, etc.) */
+static inline void VGA_DirtyInvalidate(void) {
+	vga_dirty.invalidate = true;
+}
+
 /* Support for modular SVGA implementation */
 /* Video mode extra data to be passed to FinishSetMode_SVGA().
    This structure will be in flux until all drivers (including S3)
@@ -23,7 +23,9 @@
 #include "../../tests/tests.h"
 
 #include <string.h>
+#include <algorithm>
 #include <list>
+#include <unordered_map>
 #include <vector>
 #include <ctype.h>
 #include <fstream>
@@ -308,7 +310,29 @@ bool	exitLoop	= false;
 
 // Heavy Debugging Vars for logging
 #if C_HEAVY_DEBUG
+// One executed instruction as captured by the cpu loggers. Records are only
+// disassembled and formatted when the log file is written.
+struct CPUTraceRecord {
+	double		time;
+	uint32_t	eip;
+	uint32_t	eax,ebx,ecx,edx,esi,edi,ebp,esp;
+	uint32_t	flags;			// reg_flags with the lazy arithmetic flags resolved
+	uint32_t	raw_flags;		// reg_flags as is, LOGL shows this
+	uint32_t	cr0;
+	uint16_t	cs,ds,es,fs,gs,ss;
+	uint32_t	mem_addr;		// linear address of the memory operand
+	uint32_t	mem_value;		// and what it held before the instruction ran
+	uint8_t		mem_valid;
+	uint8_t		big;			// cpu.code.big
+	uint8_t		code_len;		// readable instruction bytes in code
+	uint8_t		code[16];
+};
+
+static const size_t CPUTRACE_BLOCK = 8192;	// records buffered before they go to cpuLogTrace
+
 static ofstream 	cpuLogFile;
+static FILE*		cpuLogTrace		= NULL;	// binary records of the running LOG command
+static std::vector<CPUTraceRecord>	cpuLogBlock;
 static bool		cpuLog			= false;
 static int		cpuLogCounter	= 0;
 static int		cpuLogType		= 1;	// log detail
@@ -379,6 +403,11 @@ struct SCodeViewData {
 static uint16_t  dataSeg;
 static uint32_t  dataOfs;
 static bool    showExtend = true;
+
+// memory operand captured by the cpu log, AnalyzeInstruction shows it instead of current memory
+static bool     traceOperandValid = false;
+static uint32_t traceOperandAddr = 0;
+static uint32_t traceOperandValue = 0;
 static bool    showPrintable = true;
 
 static void ClearInputLine(void) {
@@ -552,11 +581,11 @@ class CBreakpoint
 public:
 
 	CBreakpoint(void);
-	void					SetAddress		(uint16_t seg, uint32_t off)	{ location = (PhysPt)GetAddress(seg,off); type = BKPNT_PHYSICAL; segment = seg; offset = off; };
-	void					SetAddress		(PhysPt adr)				{ location = adr; type = BKPNT_PHYSICAL; };
-	void					SetInt			(uint8_t _intNr, uint16_t ah, uint16_t al)	{ intNr = _intNr; ahValue = ah; alValue = al; type = BKPNT_INTERRUPT; };
+	void					SetAddress		(uint16_t seg, uint32_t off)	{ location = (PhysPt)GetAddress(seg,off); type = BKPNT_PHYSICAL; segment = seg; offset = off; indexDirty = true; };
+	void					SetAddress		(PhysPt adr)				{ location = adr; type = BKPNT_PHYSICAL; indexDirty = true; };
+	void					SetInt			(uint8_t _intNr, uint16_t ah, uint16_t al)	{ intNr = _intNr; ahValue = ah; alValue = al; type = BKPNT_INTERRUPT; indexDirty = true; };
 	void					SetOnce			(bool _once)				{ once = _once; };
-	void					SetType			(EBreakpoint _type)			{ type = _type; };
+	void					SetType			(EBreakpoint _type)			{ type = _type; indexDirty = true; };
 	void					SetValue		(uint8_t value)				{ ahValue = value; };
 	void					SetOther		(uint8_t other)				{ alValue = other; };	
 
@@ -591,6 +620,13 @@ public:
 
 
 private:
+	static void				RebuildIndex		(void);
+#if C_HEAVY_DEBUG
+	static void				HookWatchedPages	(void);
+	static void				ReleaseWatchedPages	(void);
+	static bool				WatchedPagesUnchanged	(void);
+#endif
+
 	EBreakpoint	type;
 	// Physical
 	PhysPt		location;
@@ -608,8 +644,18 @@ private:
 	bool		once;
 
 	static std::list<CBreakpoint*>	BPoints;
+
+	// Lookup tables for the active breakpoints in BPoints, rebuilt on the next check
+	// after a breakpoint is added, deleted, (de)activated or changes type/address.
+	static std::unordered_multimap<PhysPt,CBreakpoint*>	physIndex;	// BKPNT_PHYSICAL by location
+	static std::vector<uint32_t>	physPages;	// one bit per 4KB page holding an entry of physIndex
+	static std::vector<CBreakpoint*>	intIndex[256];	// BKPNT_INTERRUPT by interrupt number
+	static std::vector<CBreakpoint*>	memWatch;	// BKPNT_MEMORY*, in BPoints order
+	static bool				indexDirty;
 #if C_HEAVY_DEBUG
+	static bool				memWatchRescan;	// compare every watched byte on the next check
 	friend bool DEBUG_HeavyIsBreakpoint(void);
+	friend void DEBUG_HeavyMemoryChanged(void);
 #endif
 };
 
@@ -657,10 +703,253 @@ void CBreakpoint::Activate(bool _active)
 	}
 #endif
 	active = _active;
+	indexDirty = true;
 }
 
 // Statics
 std::list<CBreakpoint*> CBreakpoint::BPoints;
+std::unordered_multimap<PhysPt,CBreakpoint*> CBreakpoint::physIndex;
+std::vector<uint32_t> CBreakpoint::physPages;
+std::vector<CBreakpoint*> CBreakpoint::intIndex[256];
+std::vector<CBreakpoint*> CBreakpoint::memWatch;
+bool CBreakpoint::indexDirty = false;
+
+#if C_HEAVY_DEBUG
+/* Memory breakpoints compare their byte with the last value seen before every instruction. In real mode
+ * that comparison is skipped while none of the watched bytes can have changed. The pages holding them get
+ * this handler in front of their own, the way the dynamic core watches its code pages, so that every write
+ * through the CPU or the TLB is noticed. Writes that bypass page handlers (DMA, direct MemBase access) only
+ * happen outside the CPU core, and the main loop reports those through DEBUG_HeavyMemoryChanged(). */
+class WatchPageHandler : public PageHandler {
+public:
+	void SetupAt(PageNum _phys_page,PageHandler * _old_pagehandler) {
+		phys_page=_phys_page;
+		old_pagehandler=_old_pagehandler;
+		flags=old_pagehandler->flags&~PFLAG_WRITEABLE;
+	}
+
+	uint8_t readb(PhysPt addr) override {
+		if (old_pagehandler->flags & PFLAG_READABLE) return host_readb(GetHostReadPt(phys_page)+(addr&4095));
+		return old_pagehandler->readb(addr);
+	}
+	uint16_t readw(PhysPt addr) override {
+		if (old_pagehandler->flags & PFLAG_READABLE) return host_readw(GetHostReadPt(phys_page)+(addr&4095));
+		return old_pagehandler->readw(addr);
+	}
+	uint32_t readd(PhysPt addr) override {
+		if (old_pagehandler->flags & PFLAG_READABLE) return host_readd(GetHostReadPt(phys_page)+(addr&4095));
+		return old_pagehandler->readd(addr);
+	}
+	void writeb(PhysPt addr,uint8_t val) override {
+		written=true;
+		if (old_pagehandler->flags & PFLAG_WRITEABLE) host_writeb(old_pagehandler->GetHostWritePt(phys_page)+(addr&4095),val);
+		else old_pagehandler->writeb(addr,val);
+	}
+	void writew(PhysPt addr,uint16_t val) override {
+		written=true;
+		if (old_pagehandler->flags & PFLAG_WRITEABLE) host_writew(old_pagehandler->GetHostWritePt(phys_page)+(addr&4095),val);
+		else old_pagehandler->writew(addr,val);
+	}
+	void writed(PhysPt addr,uint32_t val) override {
+		written=true;
+		if (old_pagehandler->flags & PFLAG_WRITEABLE) host_writed(old_pagehandler->GetHostWritePt(phys_page)+(addr&4095),val);
+		else old_pagehandler->writed(addr,val);
+	}
+	bool readb_checked(PhysPt addr,uint8_t * val) override {
+		if (old_pagehandler->flags & PFLAG_READABLE) { *val=readb(addr); return false; }
+		return old_pagehandler->readb_checked(addr,val);
+	}
+	bool readw_checked(PhysPt addr,uint16_t * val) override {
+		if (old_pagehandler->flags & PFLAG_READABLE) { *val=readw(addr); return false; }
+		return old_pagehandler->readw_checked(addr,val);
+	}
+	bool readd_checked(PhysPt addr,uint32_t * val) override {
+		if (old_pagehandler->flags & PFLAG_READABLE) { *val=readd(addr); return false; }
+		return old_pagehandler->readd_checked(addr,val);
+	}
+	bool writeb_checked(PhysPt addr,uint8_t val) override {
+		if (old_pagehandler->flags & PFLAG_WRITEABLE) { writeb(addr,val); return false; }
+		written=true;
+		return old_pagehandler->writeb_checked(addr,val);
+	}
+	bool writew_checked(PhysPt addr,uint16_t val) override {
+		if (old_pagehandler->flags & PFLAG_WRITEABLE) { writew(addr,val); return false; }
+		written=true;
+		return old_pagehandler->writew_checked(addr,val);
+	}
+	bool writed_checked(PhysPt addr,uint32_t val) override {
+		if (old_pagehandler->flags & PFLAG_WRITEABLE) { writed(addr,val); return false; }
+		written=true;
+		return old_pagehandler->writed_checked(addr,val);
+	}
+	HostPt GetHostReadPt(PageNum _phys_page) override {
+		return old_pagehandler->GetHostReadPt(_phys_page);
+	}
+	HostPt GetHostWritePt(PageNum _phys_page) override {
+		// whoever asks is about to write behind our back
+		written=true;
+		return old_pagehandler->GetHostWritePt(_phys_page);
+	}
+
+	PageNum phys_page = 0;
+	PageHandler * old_pagehandler = nullptr;
+
+	static bool written;
+};
+
+bool WatchPageHandler::written = false;
+bool CBreakpoint::memWatchRescan = true;
+
+static std::vector<WatchPageHandler*> watchPages;	// installed, one per watched physical page
+static std::vector<WatchPageHandler*> watchPagesFree;
+static std::vector<std::pair<PageNum,PageNum> > watchLinks;	// linear to physical page of each watched byte
+static uint16_t watchCS = 0;
+static PhysPt watchCSBase = 0;
+
+static bool WatchPageInstalled(const WatchPageHandler *wph)
+{
+	return MEM_GetPageHandler(wph->phys_page) == wph;
+}
+
+void CBreakpoint::ReleaseWatchedPages(void)
+{
+	bool unlinked = false;
+	for (auto i = watchPages.begin(); i != watchPages.end(); ++i) {
+		WatchPageHandler *wph = (*i);
+		// a handler installed on top of ours (dynamic core code page) still calls into it,
+		// so it stays around as a plain pass-through
+		if (!WatchPageInstalled(wph)) continue;
+		MEM_SetPageHandler(wph->phys_page,1,wph->old_pagehandler);
+		watchPagesFree.push_back(wph);
+		unlinked = true;
+	}
+	watchPages.clear();
+	watchLinks.clear();
+	if (unlinked) PAGING_ClearTLB();
+}
+
+// Make sure each page holding a watched byte, as mapped right now, has a WatchPageHandler
+void CBreakpoint::HookWatchedPages(void)
+{
+	std::vector<WatchPageHandler*> keep;
+	bool changed = false;
+
+	watchLinks.clear();
+	for (auto i = memWatch.begin(); i != memWatch.end(); ++i) {
+		CBreakpoint *bp = (*i);
+		PhysPt address;
+		if (bp->GetType()==BKPNT_MEMORY_LINEAR) address = bp->GetOffset();
+		else address = (PhysPt)GetAddress(bp->GetSegment(),bp->GetOffset());
+
+		PageNum lin_page = address >> 12u, phys_page = lin_page;
+		if (!PAGING_MakePhysPage(phys_page)) continue;
+		const std::pair<PageNum,PageNum> link(lin_page,phys_page);
+		if (std::find(watchLinks.begin(),watchLinks.end(),link) == watchLinks.end())
+			watchLinks.push_back(link);
+
+		WatchPageHandler *wph = nullptr;
+		for (auto j = keep.begin(); j != keep.end() && !wph; ++j)
+			if ((*j)->phys_page == phys_page) wph = (*j);
+		for (auto j = watchPages.begin(); j != watchPages.end() && !wph; ++j)
+			if ((*j)->phys_page == phys_page && WatchPageInstalled(*j)) keep.push_back(wph = (*j));
+		if (wph) continue;
+
+		if (!watchPagesFree.empty()) {
+			wph = watchPagesFree.back();
+			watchPagesFree.pop_back();
+		} else {
+			wph = new WatchPageHandler();
+		}
+		wph->SetupAt(phys_page,MEM_GetPageHandler(phys_page));
+		MEM_SetPageHandler(phys_page,1,wph);
+		PAGING_UnlinkPages(lin_page,1);
+		keep.push_back(wph);
+		changed = true;
+	}
+
+	// unhook the pages nothing is watched on anymore
+	for (auto i = watchPages.begin(); i != watchPages.end(); ++i) {
+		WatchPageHandler *wph = (*i);
+		if (std::find(keep.begin(),keep.end(),wph) != keep.end() || !WatchPageInstalled(wph)) continue;
+		MEM_SetPageHandler(wph->phys_page,1,wph->old_pagehandler);
+		watchPagesFree.push_back(wph);
+		changed = true;
+	}
+	watchPages.swap(keep);
+
+	// drop the direct host pointers the TLB may still hold for those pages, through any alias
+	if (changed) PAGING_ClearTLB();
+	watchCS = SegValue(cs);
+	watchCSBase = SegPhys(cs);
+}
+
+// True if no watched byte can have changed since the last full comparison
+bool CBreakpoint::WatchedPagesUnchanged(void)
+{
+	// protected mode addresses depend on descriptors and page tables, those are always compared
+	if (memWatchRescan || cpu.pmode || WatchPageHandler::written) return false;
+	// GetAddress() uses the CS base for watches in the current code segment
+	if (SegValue(cs) != watchCS || SegPhys(cs) != watchCSBase) return false;
+
+	// A20 or a UMB/EMS mapping moved a page, or something else replaced its handler
+	for (auto i = watchLinks.begin(); i != watchLinks.end(); ++i)
+		if (i->first < LINK_START && paging.firstmb[i->first] != i->second) return false;
+	for (auto i = watchPages.begin(); i != watchPages.end(); ++i)
+		if (!WatchPageInstalled(*i)) return false;
+	return true;
+}
+
+void DEBUG_HeavyMemoryChanged(void)
+{
+	CBreakpoint::memWatchRescan = true;
+}
+#endif
+
+static inline bool BreakpointPageBit(const std::vector<uint32_t> &pages, PhysPt adr)
+{
+	return (pages[adr >> 17u] >> ((adr >> 12u) & 31u)) & 1u;
+}
+
+void CBreakpoint::RebuildIndex(void)
+{
+	// The page bitmap covers the full 32-bit address space, so only clear the bits that were set
+	if (physPages.empty()) physPages.resize((size_t)1u << 15u, 0);
+	for (auto i = physIndex.begin(); i != physIndex.end(); ++i)
+		physPages[i->first >> 17u] &= ~(1u << ((i->first >> 12u) & 31u));
+
+	physIndex.clear();
+	for (unsigned int n = 0; n < 256; n++) intIndex[n].clear();
+	memWatch.clear();
+
+	for (auto i = BPoints.begin(); i != BPoints.end(); ++i) {
+		CBreakpoint* bp = (*i);
+		if (!bp->IsActive()) continue;
+
+		switch (bp->GetType()) {
+			case BKPNT_PHYSICAL:
+				physIndex.emplace(bp->GetLocation(), bp);
+				physPages[bp->GetLocation() >> 17u] |= 1u << ((bp->GetLocation() >> 12u) & 31u);
+				break;
+			case BKPNT_INTERRUPT:
+				intIndex[bp->GetIntNr()].push_back(bp);
+				break;
+			case BKPNT_MEMORY:
+			case BKPNT_MEMORY_PROT:
+			case BKPNT_MEMORY_LINEAR:
+			case BKPNT_MEMORY_FREEZE:
+				memWatch.push_back(bp);
+				break;
+			default:
+				break;
+		}
+	}
+
+	indexDirty = false;
+#if C_HEAVY_DEBUG
+	memWatchRescan = true;
+	if (memWatch.empty()) ReleaseWatchedPages();
+#endif
+}
 
 CBreakpoint* CBreakpoint::AddBreakpoint(uint16_t seg, uint32_t off, bool once)
 {
@@ -724,17 +1013,18 @@ bool CBreakpoint::CheckBreakpoint(uint16_t seg, uint32_t off)
 {
 	// Quick exit if there are no breakpoints
 	if (BPoints.empty()) return false;
+	if (indexDirty) RebuildIndex();
 
-	// Search matching breakpoint
-	for (auto i = BPoints.begin(); i != BPoints.end(); ++i) {
-		CBreakpoint *bp = (*i);
+	// Search matching breakpoint, most addresses are rejected by the page bitmap alone
+	const PhysPt adr = (PhysPt)GetAddress(seg, off);
+	if (BreakpointPageBit(physPages, adr)) {
+		auto found = physIndex.find(adr);
+		if (found != physIndex.end()) {
+			CBreakpoint *bp = found->second;
 
-		if ((bp->GetType() == BKPNT_PHYSICAL) && bp->IsActive() &&
-		    (bp->GetLocation() == GetAddress(seg, off))) {
-			// Found
 			if (bp->GetOnce()) {
 				// delete it, if it should only be used once
-				(BPoints.erase)(i);
+				BPoints.remove(bp);
 				bp->Activate(false);
 				delete bp;
 			} else {
@@ -748,39 +1038,48 @@ bool CBreakpoint::CheckBreakpoint(uint16_t seg, uint32_t off)
 			}
 			return true;
 		}
+	}
 #if C_HEAVY_DEBUG
-		// Memory breakpoint support
-		else if (bp->IsActive()) {
-			if ((bp->GetType()==BKPNT_MEMORY) || (bp->GetType()==BKPNT_MEMORY_PROT) || (bp->GetType()==BKPNT_MEMORY_LINEAR) || (bp->GetType()==BKPNT_MEMORY_FREEZE)) {
-				// Watch Protected Mode Memoryonly in pmode
-				if (bp->GetType()==BKPNT_MEMORY_PROT) {
-					// Check if pmode is active
-					if (!cpu.pmode) return false;
-					// Check if descriptor is valid
-					Descriptor desc;
-					if (!cpu.gdt.GetDescriptor(bp->GetSegment(),desc)) return false;
-					if (desc.GetLimit()==0) return false;
-				}
+	// Memory breakpoint support
+	if (memWatch.empty() || WatchedPagesUnchanged()) return false;
 
-				Bitu address; 
-				if (bp->GetType()==BKPNT_MEMORY_LINEAR) address = bp->GetOffset();
-				else address = (Bitu)GetAddress(bp->GetSegment(),bp->GetOffset());
-				uint8_t value=0;
-				if (mem_readb_checked((PhysPt)address,&value)) return false;
-				if (bp->GetValue() != value) {
-					// Yup, memory value changed
-                    if (bp->GetType()==BKPNT_MEMORY_FREEZE){
-                        mem_writeb_checked((PhysPt)address,bp->GetValue());
-                        return false;
-                    }
-					DEBUG_ShowMsg("DEBUG: Memory breakpoint %s: %04X:%04X - %02X -> %02X\n",(bp->GetType()==BKPNT_MEMORY_PROT)?"(Prot)":"",bp->GetSegment(),bp->GetOffset(),bp->GetValue(),value);
-					bp->SetValue(value);
-					return true;
-				}
+	// Compare every watched byte, and keep doing so on each instruction until a comparison
+	// gets through all of them without stopping
+	memWatchRescan = true;
+	if (!cpu.pmode) HookWatchedPages();
+	WatchPageHandler::written = false;
+
+	for (auto i = memWatch.begin(); i != memWatch.end(); ++i) {
+		CBreakpoint *bp = (*i);
+
+		// Watch Protected Mode Memoryonly in pmode
+		if (bp->GetType()==BKPNT_MEMORY_PROT) {
+			// Check if pmode is active
+			if (!cpu.pmode) return false;
+			// Check if descriptor is valid
+			Descriptor desc;
+			if (!cpu.gdt.GetDescriptor(bp->GetSegment(),desc)) return false;
+			if (desc.GetLimit()==0) return false;
+		}
+
+		Bitu address; 
+		if (bp->GetType()==BKPNT_MEMORY_LINEAR) address = bp->GetOffset();
+		else address = (Bitu)GetAddress(bp->GetSegment(),bp->GetOffset());
+		uint8_t value=0;
+		if (mem_readb_checked((PhysPt)address,&value)) return false;
+		if (bp->GetValue() != value) {
+			// Yup, memory value changed
+			if (bp->GetType()==BKPNT_MEMORY_FREEZE){
+				mem_writeb_checked((PhysPt)address,bp->GetValue());
+				return false;
 			}
+			DEBUG_ShowMsg("DEBUG: Memory breakpoint %s: %04X:%04X - %02X -> %02X\n",(bp->GetType()==BKPNT_MEMORY_PROT)?"(Prot)":"",bp->GetSegment(),bp->GetOffset(),bp->GetValue(),value);
+			bp->SetValue(value);
+			return true;
 		}
-#endif
 	}
+	memWatchRescan = false;
+#endif
 	return false;
 }
 
@@ -788,26 +1087,25 @@ bool CBreakpoint::CheckIntBreakpoint(PhysPt adr, uint8_t intNr, uint16_t ahValue
 // Checks if interrupt breakpoint is valid and should stop execution
 {
 	if (BPoints.empty()) return false;
+	if (indexDirty) RebuildIndex();
 
     // unused
     (void)adr;
 
 	// Search matching breakpoint
-	std::list<CBreakpoint*>::iterator i;
-	for(i=BPoints.begin(); i != BPoints.end(); ++i) {
+	const std::vector<CBreakpoint*> &candidates = intIndex[intNr];
+	for (auto i = candidates.begin(); i != candidates.end(); ++i) {
 		CBreakpoint* bp = (*i);
-		if ((bp->GetType()==BKPNT_INTERRUPT) && bp->IsActive() && (bp->GetIntNr()==intNr)) {
-			if (((bp->GetValue()==BPINT_ALL) || (bp->GetValue()==ahValue)) && ((bp->GetOther()==BPINT_ALL) || (bp->GetOther()==alValue))) {
-				// Ignore it once ?
-				// Found
-				if (bp->GetOnce()) {
-					// delete it, if it should only be used once
-					(BPoints.erase)(i);
-					bp->Activate(false);
-					delete bp;
-				}
-				return true;
+		if (((bp->GetValue()==BPINT_ALL) || (bp->GetValue()==ahValue)) && ((bp->GetOther()==BPINT_ALL) || (bp->GetOther()==alValue))) {
+			// Ignore it once ?
+			// Found
+			if (bp->GetOnce()) {
+				// delete it, if it should only be used once
+				BPoints.remove(bp);
+				bp->Activate(false);
+				delete bp;
 			}
+			return true;
 		}
 	}
 	return false;
@@ -822,6 +1120,7 @@ void CBreakpoint::DeleteAll()
 		delete bp;
 	}
 	(BPoints.clear)();
+	RebuildIndex();
 }
 
 
@@ -837,6 +1136,7 @@ bool CBreakpoint::DeleteByIndex(uint16_t index)
 			(BPoints.erase)(i);
 			bp->Activate(false);
 			delete bp;
+			RebuildIndex();
 			return true;
 		}
 		nr++;
@@ -893,6 +1193,7 @@ bool CBreakpoint::DeleteBreakpoint(uint16_t seg, uint32_t off)
 	if (bp) {
 		BPoints.remove(bp);
 		delete bp;
+		indexDirty = true;
 		return true;
 	}
 
@@ -2787,6 +3088,14 @@ bool ParseCommand(char* str) {
 		}
 		//Initialize log object
 		cpuLogFile << hex << noshowbase << setfill('0') << uppercase;
+		cpuLogTrace = tmpfile();
+		if (cpuLogTrace == NULL) {
+			DEBUG_ShowMsg("DEBUG: Logfile couldn't be created.\n");
+			cpuLogFile.close();
+			return false;
+		}
+		cpuLogBlock.clear();
+		cpuLogBlock.reserve(CPUTRACE_BLOCK);
 		cpuLog = true;
 		cpuLogCounter = (int)GetHexValue(found,found);
 
@@ -4089,20 +4398,22 @@ char* AnalyzeInstruction(char* inst, bool saveSelector) {
 				pos++;
 		}
 		uint32_t address = (uint32_t)GetAddress(seg,adr);
-		if (!(get_tlb_readhandler(address)->flags & PFLAG_INIT)) {
+		// a cpu log shows the operand as it was when the instruction was recorded
+		const bool traced = traceOperandValid && traceOperandAddr == address;
+		if (traced || !(get_tlb_readhandler(address)->flags & PFLAG_INIT)) {
 			static char outmask[] = "%s:[%04X]=%02X";
 
 			if (cpu.pmode) outmask[6] = '8';
 				switch (DasmLastOperandSize()) {
-				case 8 : {	uint8_t val = mem_readb(address);
+				case 8 : {	uint8_t val = traced ? (uint8_t)traceOperandValue : mem_readb(address);
 							outmask[12] = '2';
 							sprintf(result,outmask,prefix,adr,val);
 						}	break;
-				case 16: {	uint16_t val = mem_readw(address);
+				case 16: {	uint16_t val = traced ? (uint16_t)traceOperandValue : mem_readw(address);
 							outmask[12] = '4';
 							sprintf(result,outmask,prefix,adr,val);
 						}	break;
-				case 32: {	uint32_t val = mem_readd(address);
+				case 32: {	uint32_t val = traced ? traceOperandValue : mem_readd(address);
 							outmask[12] = '8';
 							sprintf(result,outmask,prefix,adr,val);
 						}	break;
@@ -4295,6 +4606,9 @@ extern "C" INPUT_RECORD * _pdcurses_hax_inputrecord(void);
  *      specifically PIC_TickIndex() and PIC_FullIndex(). */
 int32_t DEBUG_Run(int32_t amount,bool quickexit) {
 	skipFirstInstruction = true;
+#if C_HEAVY_DEBUG
+	DEBUG_HeavyMemoryChanged();
+#endif
 	CPU_CycleLeft += CPU_Cycles - amount;
 	CPU_Cycles = amount;
 	int32_t ret = (int32_t)(*cpudecoder)();
@@ -5418,20 +5732,227 @@ static void LogCPUInfo(void) {
 }
 
 #if C_HEAVY_DEBUG
-static void LogInstruction(uint16_t segValue, uint32_t eipValue,  ofstream& out) {
+// Work out the linear address of the ModRM or moffs memory operand of the
+// instruction in rec.code from the live cpu state. Instructions without one,
+// and string instructions, return false.
+static bool CPUTrace_OperandAddress(const CPUTraceRecord &rec, uint32_t &address) {
+	const uint8_t* code = rec.code;
+	const Bitu len = rec.code_len;
+	bool adr32 = rec.big != 0;
+	SegNames seg = ds;
+	bool seg_override = false;
+	Bitu i = 0;
+
+	for (;;i++) {
+		if (i >= len) return false;
+		switch (code[i]) {
+		case 0x26: seg = es; seg_override = true; continue;
+		case 0x2e: seg = cs; seg_override = true; continue;
+		case 0x36: seg = ss; seg_override = true; continue;
+		case 0x3e: seg = ds; seg_override = true; continue;
+		case 0x64: seg = fs; seg_override = true; continue;
+		case 0x65: seg = gs; seg_override = true; continue;
+		case 0x67: adr32 = !adr32; continue;
+		case 0x66: case 0xf0: case 0xf2: case 0xf3: continue;
+		}
+		break;
+	}
+
+	const uint8_t op = code[i++];
+	uint32_t offset;
+	if (op >= 0xa0 && op <= 0xa3) { // mov al/ax,[moffs] and back
+		const Bitu size = adr32 ? 4 : 2;
+		if (i + size > len) return false;
+		offset = 0;
+		for (Bitu b = 0; b < size; b++) offset |= (uint32_t)code[i + b] << (b * 8u);
+		address = (uint32_t)(SegPhys(seg) + offset);
+		return true;
+	}
+
+	bool modrm;
+	if (op == 0x0f) {
+		if (i >= len) return false;
+		const uint8_t op2 = code[i++];
+		switch (op2) {
+		case 0x05: case 0x06: case 0x07: case 0x08: case 0x09: case 0x0a: case 0x0b: case 0x0e:
+		case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x37: case 0x77:
+		case 0xa0: case 0xa1: case 0xa2: case 0xa8: case 0xa9: case 0xaa:
+			modrm = false;
+			break;
+		default:
+			modrm = !(op2 >= 0x80 && op2 <= 0x8f) && !(op2 >= 0xc8 && op2 <= 0xcf);
+			break;
+		}
+	} else if (op < 0x40) {
+		modrm = (op & 0x04) == 0;
+	} else {
+		switch (op) {
+		case 0x62: case 0x63: case 0x69: case 0x6b:
+		case 0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x86: case 0x87:
+		case 0x88: case 0x89: case 0x8a: case 0x8b: case 0x8c: case 0x8d: case 0x8e: case 0x8f:
+		case 0xc0: case 0xc1: case 0xc4: case 0xc5: case 0xc6: case 0xc7:
+		case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+		case 0xd8: case 0xd9: case 0xda: case 0xdb: case 0xdc: case 0xdd: case 0xde: case 0xdf:
+		case 0xf6: case 0xf7: case 0xfe: case 0xff:
+			modrm = true;
+			break;
+		default:
+			modrm = false;
+			break;
+		}
+	}
+	if (!modrm || i >= len) return false;
+
+	const uint8_t rm = code[i++];
+	const unsigned int mod = rm >> 6u;
+	if (mod == 3) return false;
+	const uint32_t regs32[8] = { rec.eax,rec.ecx,rec.edx,rec.ebx,rec.esp,rec.ebp,rec.esi,rec.edi };
+	bool stack = false;
+	Bitu disp_size = (mod == 1) ? 1 : ((mod == 2) ? (adr32 ? 4 : 2) : 0);
+
+	if (!adr32) {
+		static const uint8_t base16[8] = { 3,3,5,5,6,7,5,3 };	// bx,bx,bp,bp,si,di,bp,bx
+		static const uint8_t index16[8] = { 6,7,6,7,8,8,8,8 };	// si,di,si,di,none
+		const unsigned int r = rm & 7u;
+		if (mod == 0 && r == 6) {
+			offset = 0;
+			disp_size = 2;
+		} else {
+			offset = regs32[base16[r]];
+			if (index16[r] < 8) offset += regs32[index16[r]];
+			stack = (base16[r] == 5);
+		}
+	} else {
+		unsigned int base = rm & 7u;
+		offset = 0;
+		if (base == 4) { // SIB
+			if (i >= len) return false;
+			const uint8_t sib = code[i++];
+			const unsigned int index = (sib >> 3u) & 7u;
+			base = sib & 7u;
+			if (index != 4) offset = regs32[index] << (sib >> 6u);
+			if (mod == 0 && base == 5) disp_size = 4;
+			else {
+				offset += regs32[base];
+				stack = (base == 4 || base == 5);
+			}
+		} else if (mod == 0 && base == 5) {
+			disp_size = 4;
+		} else {
+			offset = regs32[base];
+			stack = (base == 5);
+		}
+	}
+
+	if (i + disp_size > len) return false;
+	if (disp_size == 1) offset += (uint32_t)(int32_t)(int8_t)code[i];
+	else if (disp_size == 2) offset += (uint32_t)(code[i] | (code[i + 1] << 8u));
+	else if (disp_size == 4) offset += (uint32_t)code[i] | ((uint32_t)code[i + 1] << 8u) | ((uint32_t)code[i + 2] << 16u) | ((uint32_t)code[i + 3] << 24u);
+	if (!adr32) offset &= 0xffff;
+
+	if (stack && !seg_override) seg = ss;
+	address = (uint32_t)(SegPhys(seg) + offset);
+	return true;
+}
+
+static void CPUTrace_Capture(CPUTraceRecord &rec) {
+	rec.time = (double)PIC_FullIndex();
+	rec.eip  = reg_eip;
+	rec.eax  = reg_eax;
+	rec.ebx  = reg_ebx;
+	rec.ecx  = reg_ecx;
+	rec.edx  = reg_edx;
+	rec.esi  = reg_esi;
+	rec.edi  = reg_edi;
+	rec.ebp  = reg_ebp;
+	rec.esp  = reg_esp;
+	rec.raw_flags = (uint32_t)reg_flags;
+	rec.flags = (uint32_t)(reg_flags & ~(Bitu)(FLAG_CF|FLAG_PF|FLAG_AF|FLAG_ZF|FLAG_SF|FLAG_OF));
+	if (get_CF()) rec.flags |= FLAG_CF;
+	if (get_PF()) rec.flags |= FLAG_PF;
+	if (get_AF()) rec.flags |= FLAG_AF;
+	if (get_ZF()) rec.flags |= FLAG_ZF;
+	if (get_SF()) rec.flags |= FLAG_SF;
+	if (get_OF()) rec.flags |= FLAG_OF;
+	rec.cr0  = (uint32_t)cpu.cr0;
+	rec.cs   = (uint16_t)SegValue(cs);
+	rec.ds   = (uint16_t)SegValue(ds);
+	rec.es   = (uint16_t)SegValue(es);
+	rec.fs   = (uint16_t)SegValue(fs);
+	rec.gs   = (uint16_t)SegValue(gs);
+	rec.ss   = (uint16_t)SegValue(ss);
+	rec.big  = cpu.code.big ? 1 : 0;
+
+	// an x86 instruction is at most 15 bytes long
+	const PhysPt start = (PhysPt)GetAddress(rec.cs,rec.eip);
+	rec.code_len = 0;
+	while (rec.code_len < 15 && !mem_readb_checked((PhysPt)(start + rec.code_len),&rec.code[rec.code_len]))
+		rec.code_len++;
+
+	// the memory operand is gone by the time the log is written, keep its value
+	rec.mem_valid = 0;
+	rec.mem_value = 0;
+	if (CPUTrace_OperandAddress(rec,rec.mem_addr)) {
+		rec.mem_valid = 1;
+		for (unsigned int i = 0; i < 4; i++) {
+			uint8_t value;
+			if (mem_readb_checked((PhysPt)(rec.mem_addr + i),&value)) {
+				rec.mem_valid = 0;
+				break;
+			}
+			rec.mem_value |= (uint32_t)value << (i * 8u);
+		}
+	}
+}
+
+// AnalyzeInstruction() evaluates operands against the live cpu state, so put the
+// recorded registers in place while it runs. The memory operand comes from the record.
+static char* CPUTrace_Analyze(const CPUTraceRecord &rec, char* dline) {
+	const CPU_Regs saved_regs = cpu_regs;
+	const Segments saved_segs = Segs;
+	const LazyFlags saved_lflags = lflags;
+	const bool saved_pmode = cpu.pmode;
+
+	reg_eax = rec.eax; reg_ebx = rec.ebx; reg_ecx = rec.ecx; reg_edx = rec.edx;
+	reg_esi = rec.esi; reg_edi = rec.edi; reg_ebp = rec.ebp; reg_esp = rec.esp;
+	reg_eip = rec.eip;
+	reg_flags = rec.flags;
+	lflags.type = t_UNKNOWN;
+	cpu.pmode = (rec.cr0 & CR0_PROTECTION) != 0;
+
+	const SegNames names[6] = { es,cs,ss,ds,fs,gs };
+	const uint16_t values[6] = { rec.es,rec.cs,rec.ss,rec.ds,rec.fs,rec.gs };
+	for (unsigned int i = 0; i < 6; i++) {
+		Segs.val[names[i]] = values[i];
+		if (!cpu.pmode || (rec.flags & FLAG_VM)) Segs.phys[names[i]] = (PhysPt)values[i] << 4u;
+	}
+
+	traceOperandValid = rec.mem_valid != 0;
+	traceOperandAddr = rec.mem_addr;
+	traceOperandValue = rec.mem_value;
+	char* res = AnalyzeInstruction(dline,false);
+	traceOperandValid = false;
+
+	cpu_regs = saved_regs;
+	Segs = saved_segs;
+	lflags = saved_lflags;
+	cpu.pmode = saved_pmode;
+	return res;
+}
+
+static void LogInstruction(const CPUTraceRecord &rec, int logType, ostream& out) {
 	static char empty[23] = { 32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,0 };
 
-	if (cpuLogType == 3) { //Log only cs:ip.
-		out << setw(4) << SegValue(cs) << ":" << setw(8) << reg_eip << endl;
+	if (logType == 3) { //Log only cs:ip.
+		out << setw(4) << rec.cs << ":" << setw(8) << rec.eip << endl;
 		return;
 	}
 
-	PhysPt start = (PhysPt)GetAddress(segValue,eipValue);
 	char dline[200];Bitu size;
-	size = DasmI386(dline, start, reg_eip, cpu.code.big);
+	size = DasmI386Code(dline, rec.code, rec.code_len, rec.eip, rec.big != 0);
 	char* res = empty;
-	if (showExtend && (cpuLogType > 0)) {
-		res = AnalyzeInstruction(dline,false);
+	if (showExtend && (logType > 0)) {
+		res = CPUTrace_Analyze(rec, dline);
 		if (!res || !(*res)) res = empty;
 		Bitu reslen = strlen(res);
 		if (reslen < 22) {
@@ -5447,18 +5968,17 @@ static void LogInstruction(uint16_t segValue, uint32_t eipValue,  ofstream& out)
 
 	// Get register values
 
-	if(cpuLogType == 0) {
-		out << setw(4) << SegValue(cs) << ":" << setw(4) << reg_eip << "  " << dline;
-	} else if (cpuLogType == 1) {
-		out << setw(4) << SegValue(cs) << ":" << setw(8) << reg_eip << "  " << dline << "  " << res;
-	} else if (cpuLogType == 2) {
+	if(logType == 0) {
+		out << setw(4) << rec.cs << ":" << setw(4) << rec.eip << "  " << dline;
+	} else if (logType == 1) {
+		out << setw(4) << rec.cs << ":" << setw(8) << rec.eip << "  " << dline << "  " << res;
+	} else if (logType == 2) {
 		char ibytes[200]="";
 		char tstamp[128];
 		char tmpc[200];
 		for (Bitu i=0; i<size; i++) {
-			uint8_t value;
-			if (mem_readb_checked((PhysPt)(start+i),&value)) sprintf(tmpc,"%s","?? ");
-			else sprintf(tmpc,"%02X ",value);
+			if (i >= rec.code_len) sprintf(tmpc,"%s","?? ");
+			else sprintf(tmpc,"%02X ",rec.code[i]);
 			strcat(ibytes,tmpc);
 		}
 		len = strlen(ibytes);
@@ -5466,32 +5986,64 @@ static void LogInstruction(uint16_t segValue, uint32_t eipValue,  ofstream& out)
 			for (Bitu i = 0; i < 21 - len; i++) ibytes[len + i] = ' ';
 			ibytes[21] = 0;
 		}
-		sprintf(tstamp,"%.6f",(double)PIC_FullIndex());
-		out << tstamp << " " << setw(4) << SegValue(cs) << ":" << setw(8) << reg_eip << "  " << dline << "  " << res << "  " << ibytes;
+		sprintf(tstamp,"%.6f",rec.time);
+		out << tstamp << " " << setw(4) << rec.cs << ":" << setw(8) << rec.eip << "  " << dline << "  " << res << "  " << ibytes;
 	}
 
-	out << " EAX:" << setw(8) << reg_eax << " EBX:" << setw(8) << reg_ebx
-		<< " ECX:" << setw(8) << reg_ecx << " EDX:" << setw(8) << reg_edx
-		<< " ESI:" << setw(8) << reg_esi << " EDI:" << setw(8) << reg_edi
-		<< " EBP:" << setw(8) << reg_ebp << " ESP:" << setw(8) << reg_esp
-		<< " DS:"  << setw(4) << SegValue(ds)<< " ES:"  << setw(4) << SegValue(es);
+	out << " EAX:" << setw(8) << rec.eax << " EBX:" << setw(8) << rec.ebx
+		<< " ECX:" << setw(8) << rec.ecx << " EDX:" << setw(8) << rec.edx
+		<< " ESI:" << setw(8) << rec.esi << " EDI:" << setw(8) << rec.edi
+		<< " EBP:" << setw(8) << rec.ebp << " ESP:" << setw(8) << rec.esp
+		<< " DS:"  << setw(4) << rec.ds << " ES:"  << setw(4) << rec.es;
 
-	if(cpuLogType == 0) {
-		out << " SS:"  << setw(4) << SegValue(ss) << " C"  << (get_CF()>0)  << " Z"   << (get_ZF()>0)
-			<< " S" << (get_SF()>0) << " O"  << (get_OF()>0) << " I"  << GETFLAGBOOL(IF);
+	if(logType == 0) {
+		out << " SS:"  << setw(4) << rec.ss << " C"  << ((rec.flags & FLAG_CF) != 0) << " Z"   << ((rec.flags & FLAG_ZF) != 0)
+			<< " S" << ((rec.flags & FLAG_SF) != 0) << " O"  << ((rec.flags & FLAG_OF) != 0) << " I"  << ((rec.flags & FLAG_IF) != 0);
 	} else {
-		out << " FS:"  << setw(4) << SegValue(fs) << " GS:"  << setw(4) << SegValue(gs)
-			<< " SS:"  << setw(4) << SegValue(ss)
-			<< " CF:"  << (get_CF()>0)  << " ZF:"   << (get_ZF()>0)  << " SF:"  << (get_SF()>0)
-			<< " OF:"  << (get_OF()>0)  << " AF:"   << (get_AF()>0)  << " PF:"  << (get_PF()>0)
-			<< " IF:"  << GETFLAGBOOL(IF);
+		out << " FS:"  << setw(4) << rec.fs << " GS:"  << setw(4) << rec.gs
+			<< " SS:"  << setw(4) << rec.ss
+			<< " CF:"  << ((rec.flags & FLAG_CF) != 0) << " ZF:"   << ((rec.flags & FLAG_ZF) != 0) << " SF:"  << ((rec.flags & FLAG_SF) != 0)
+			<< " OF:"  << ((rec.flags & FLAG_OF) != 0) << " AF:"   << ((rec.flags & FLAG_AF) != 0) << " PF:"  << ((rec.flags & FLAG_PF) != 0)
+			<< " IF:"  << ((rec.flags & FLAG_IF) != 0);
 	}
-	if(cpuLogType == 2) {
-		out << " TF:" << GETFLAGBOOL(TF) << " VM:" << GETFLAGBOOL(VM) <<" FLG:" << setw(8) << reg_flags
-			<< " CR0:" << setw(8) << cpu.cr0;
+	if(logType == 2) {
+		out << " TF:" << ((rec.flags & FLAG_TF) != 0) << " VM:" << ((rec.flags & FLAG_VM) != 0) <<" FLG:" << setw(8) << rec.raw_flags
+			<< " CR0:" << setw(8) << rec.cr0;
 	}
 	out << endl;
 }
+
+// Append the current instruction to the running LOG command
+static void CPUTrace_Log(void) {
+	cpuLogBlock.emplace_back();
+	CPUTrace_Capture(cpuLogBlock.back());
+	if (cpuLogBlock.size() >= CPUTRACE_BLOCK) {
+		fwrite(&cpuLogBlock[0],sizeof(CPUTraceRecord),cpuLogBlock.size(),cpuLogTrace);
+		cpuLogBlock.clear();
+	}
+}
+
+// Decode everything the LOG command recorded into LOGCPU.TXT
+static void CPUTrace_WriteLog(void) {
+	if (cpuLogTrace != NULL) {
+		if (!cpuLogBlock.empty())
+			fwrite(&cpuLogBlock[0],sizeof(CPUTraceRecord),cpuLogBlock.size(),cpuLogTrace);
+		cpuLogBlock.resize(CPUTRACE_BLOCK);
+		rewind(cpuLogTrace);
+
+		size_t count;
+		while ((count = fread(&cpuLogBlock[0],sizeof(CPUTraceRecord),CPUTRACE_BLOCK,cpuLogTrace)) != 0) {
+			for (size_t i = 0; i < count; i++)
+				LogInstruction(cpuLogBlock[i],cpuLogType,cpuLogFile);
+		}
+
+		fclose(cpuLogTrace);
+		cpuLogTrace = NULL;
+	}
+	cpuLogBlock.clear();
+	cpuLogFile.flush();
+	cpuLogFile.close();
+}
 #endif
 
 #if 0
@@ -5886,84 +6438,16 @@ const uint32_t LOGCPUMAX = 20000;
 
 static uint32_t logCount = 0;
 
-struct TLogInst {
-	uint16_t s_cs;
-	uint32_t eip;
-	uint32_t eax;
-	uint32_t ebx;
-	uint32_t ecx;
-	uint32_t edx;
-	uint32_t esi;
-	uint32_t edi;
-	uint32_t ebp;
-	uint32_t esp;
-	uint16_t s_ds;
-	uint16_t s_es;
-	uint16_t s_fs;
-	uint16_t s_gs;
-	uint16_t s_ss;
-	bool c;
-	bool z;
-	bool s;
-	bool o;
-	bool a;
-	bool p;
-	bool i;
-	char dline[31];
-	char res[23];
-};
+static bool logWrapped = false;
 
-TLogInst logInst[LOGCPUMAX];
+CPUTraceRecord logInst[LOGCPUMAX];
 
 void DEBUG_HeavyLogInstruction(void) {
-
-	static char empty[23] = { 32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,32,0 };
-
-	PhysPt start = (PhysPt)GetAddress(SegValue(cs),reg_eip);
-	char dline[200];
-	DasmI386(dline, start, reg_eip, cpu.code.big);
-	char* res = empty;
-	if (showExtend) {
-		res = AnalyzeInstruction(dline,false);
-		if (!res || !(*res)) res = empty;
-		Bitu reslen = strlen(res);
-        if (reslen < 22) {
-            memset(res + reslen, ' ', 22 - reslen);
-            res[22] = 0;
-        }
+	CPUTrace_Capture(logInst[logCount]);
+	if (++logCount >= LOGCPUMAX) {
+		logCount = 0;
+		logWrapped = true;
 	}
-
-	Bitu len = strlen(dline);
-	if (len < 30) memset(dline + len,' ',30 - len);
-	dline[30] = 0;
-
-	TLogInst & inst = logInst[logCount];
-	strcpy(inst.dline,dline);
-	inst.s_cs = SegValue(cs);
-	inst.eip  = reg_eip;
-	strcpy(inst.res,res);
-	inst.eax  = reg_eax;
-	inst.ebx  = reg_ebx;
-	inst.ecx  = reg_ecx;
-	inst.edx  = reg_edx;
-	inst.esi  = reg_esi;
-	inst.edi  = reg_edi;
-	inst.ebp  = reg_ebp;
-	inst.esp  = reg_esp;
-	inst.s_ds = SegValue(ds);
-	inst.s_es = SegValue(es);
-	inst.s_fs = SegValue(fs);
-	inst.s_gs = SegValue(gs);
-	inst.s_ss = SegValue(ss);
-	inst.c    = get_CF()>0;
-	inst.z    = get_ZF()>0;
-	inst.s    = get_SF()>0;
-	inst.o    = get_OF()>0;
-	inst.a    = get_AF()>0;
-	inst.p    = get_PF()>0;
-	inst.i    = GETFLAGBOOL(IF);
-
-	if (++logCount >= LOGCPUMAX) logCount = 0;
 }
 
 void DEBUG_HeavyWriteLogInstruction(void) {
@@ -5978,28 +6462,14 @@ void DEBUG_HeavyWriteLogInstruction(void) {
 		return;
 	}
 	out << hex << noshowbase << setfill('0') << uppercase;
-	uint32_t startLog = logCount;
-	do {
-		// Write Instructions
-		TLogInst & inst = logInst[startLog];
-		out << setw(4) << inst.s_cs << ":" << setw(8) << inst.eip << "  "
-		    << inst.dline << "  " << inst.res << " EAX:" << setw(8)<< inst.eax
-		    << " EBX:" << setw(8) << inst.ebx << " ECX:" << setw(8) << inst.ecx
-		    << " EDX:" << setw(8) << inst.edx << " ESI:" << setw(8) << inst.esi
-		    << " EDI:" << setw(8) << inst.edi << " EBP:" << setw(8) << inst.ebp
-		    << " ESP:" << setw(8) << inst.esp << " DS:"  << setw(4) << inst.s_ds
-		    << " ES:"  << setw(4) << inst.s_es<< " FS:"  << setw(4) << inst.s_fs
-		    << " GS:"  << setw(4) << inst.s_gs<< " SS:"  << setw(4) << inst.s_ss
-		    << " CF:"  << inst.c  << " ZF:"   << inst.z  << " SF:"  << inst.s
-		    << " OF:"  << inst.o  << " AF:"   << inst.a  << " PF:"  << inst.p
-		    << " IF:"  << inst.i  << endl;
-
-/*		fprintf(f,"%04X:%08X   %s  %s  EAX:%08X EBX:%08X ECX:%08X EDX:%08X ESI:%08X EDI:%08X EBP:%08X ESP:%08X DS:%04X ES:%04X FS:%04X GS:%04X SS:%04X CF:%01X ZF:%01X SF:%01X OF:%01X AF:%01X PF:%01X IF:%01X\n",
-			logInst[startLog].s_cs,logInst[startLog].eip,logInst[startLog].dline,logInst[startLog].res,logInst[startLog].eax,logInst[startLog].ebx,logInst[startLog].ecx,logInst[startLog].edx,logInst[startLog].esi,logInst[startLog].edi,logInst[startLog].ebp,logInst[startLog].esp,
-		        logInst[startLog].s_ds,logInst[startLog].s_es,logInst[startLog].s_fs,logInst[startLog].s_gs,logInst[startLog].s_ss,
-		        logInst[startLog].c,logInst[startLog].z,logInst[startLog].s,logInst[startLog].o,logInst[startLog].a,logInst[startLog].p,logInst[startLog].i);*/
-		if (++startLog >= LOGCPUMAX) startLog = 0;
-	} while (startLog != logCount);
+	uint32_t startLog = logWrapped ? logCount : 0;
+	if (logWrapped || logCount != 0) {
+		do {
+			// Write Instructions
+			LogInstruction(logInst[startLog],1,out);
+			if (++startLog >= LOGCPUMAX) startLog = 0;
+		} while (startLog != logCount);
+	}
 
 	out.close();
 	DEBUG_ShowMsg("DEBUG: Done.\n");
@@ -6008,12 +6478,11 @@ void DEBUG_HeavyWriteLogInstruction(void) {
 bool DEBUG_HeavyIsBreakpoint(void) {
 	if (cpuLog) {
 		if (cpuLogCounter>0) {
-			LogInstruction(SegValue(cs),reg_eip,cpuLogFile);
+			CPUTrace_Log();
 			cpuLogCounter--;
 		}
 		if (cpuLogCounter<=0) {
-			cpuLogFile.flush();
-			cpuLogFile.close();
+			CPUTrace_WriteLog();
 			DEBUG_ShowMsg("DEBUG: cpu log LOGCPU.TXT created\n");
 			cpuLog = false;
 			DEBUG_EnableDebugger();
@@ -6046,7 +6515,7 @@ bool DEBUG_HeavyIsBreakpoint(void) {
 void DEBUG_StopLog(void) {
 	if (cpuLog) {
         cpuLogCounter = 0;
-        cpuLogFile.close();
+        CPUTrace_WriteLog();
         DEBUG_ShowMsg("DEBUG: cpu log LOGCPU.TXT stopped\n");
         cpuLog = false;
     }
@@ -654,10 +654,17 @@ static char *addr_to_hex(UINT32 addr, int splitup) {
 
 static PhysPt getbyte_mac;
 static PhysPt startPtr;
+static const uint8_t *getbyte_code = NULL;	/* DasmI386Code: instruction bytes come from here instead of memory */
+static Bitu getbyte_code_len = 0;
 
 static UINT8 getbyte(void) {
     uint8_t c;
 
+	if (getbyte_code) {
+		const Bitu i = (Bitu)(getbyte_mac++ - startPtr);
+		return (i < getbyte_code_len) ? getbyte_code[i] : 0xFF;
+	}
+
 	if (!mem_readb_checked(getbyte_mac++,&c))
         return c;
 
@@ -1355,6 +1362,16 @@ Bitu DasmI386(char* buffer, PhysPt pc, uint32_t cur_ip, bool bit32)
 	return getbyte_mac-pc;
 }
 
+/* Same as DasmI386, but disassembles previously captured instruction bytes */
+Bitu DasmI386Code(char* buffer, const uint8_t* code, Bitu code_len, uint32_t cur_ip, bool bit32)
+{
+	getbyte_code = code;
+	getbyte_code_len = code_len;
+	const Bitu size = DasmI386(buffer, 0, cur_ip, bit32);
+	getbyte_code = NULL;
+	return size;
+}
+
 int DasmLastOperandSize()
 {
 	return opsize;
@@ -39,11 +39,18 @@
 
 #include <stdexcept>
 #include <exception>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
 bool log_int21 = false;
 bool log_fileio = false;
+bool log_async = false;
+unsigned int log_ratelimit = 0;
 extern bool logging_con;
 
 static bool has_LOG_Init = false;
@@ -670,6 +677,176 @@ extern bool gfx_in_mapper;
 
 bool in_debug_showmsg = false;
 
+/* Asynchronous log output. Lines for the log file and stderr go into a bounded
+ * lock-free queue (any thread may add, one thread takes) and a background thread
+ * writes and flushes them, so the emulation does not wait for the disk or the
+ * terminal. If the queue is full the line is dropped and counted. */
+#define LOG_QUEUE_SIZE 1024u /* must be a power of two */
+
+struct LogQueueSlot {
+	std::atomic<size_t>	seq;
+	bool			to_stderr;
+	char			text[512];
+};
+
+static LogQueueSlot			logQueue[LOG_QUEUE_SIZE];
+static std::atomic<size_t>		logQueueTail(0);	/* next slot to fill */
+static std::atomic<size_t>		logQueueHead(0);	/* next slot to write out */
+static std::atomic<size_t>		logQueueFlushed(0);	/* slots before this one are written and flushed */
+static std::atomic<unsigned int>	logQueueDropped(0);
+static std::atomic<bool>		logWriterRun(false);
+static std::atomic<bool>		logWriterIdle(false);
+static std::thread*			logWriter = NULL;
+static std::mutex			logWriterMutex;
+static std::condition_variable		logWriterWake;
+
+static void LOG_WriteLine(const char *text,bool to_stderr) {
+	if (debuglog != NULL)
+		fprintf(debuglog,"%s\n",text);
+	if (to_stderr) {
+#if C_EMSCRIPTEN
+		/* Emscripten routes stderr to the browser console.error() function, and
+		 * stdout to a console window below ours on the browser page. We want the
+		 * user to see our blather, so print to stdout */
+		fprintf(stdout,"LOG: %s\n",text);
+#else
+		fprintf(stderr,"LOG: %s\n",text);
+#endif
+	}
+}
+
+static void LOG_FlushLines(bool to_stderr) {
+	if (debuglog != NULL)
+		fflush(debuglog);
+	if (to_stderr) {
+#if C_EMSCRIPTEN
+		fflush(stdout);
+#else
+		fflush(stderr);
+#endif
+	}
+}
+
+static void LOG_Enqueue(const char *text,bool to_stderr) {
+	size_t pos = logQueueTail.load(std::memory_order_relaxed);
+	LogQueueSlot *slot;
+
+	for (;;) {
+		slot = &logQueue[pos & (LOG_QUEUE_SIZE - 1u)];
+		const size_t seq = slot->seq.load(std::memory_order_acquire);
+		if (seq == pos) {
+			if (logQueueTail.compare_exchange_weak(pos,pos + 1u,std::memory_order_relaxed))
+				break;
+		}
+		else if ((ptrdiff_t)(seq - pos) < 0) {
+			/* full, the writer has not caught up */
+			logQueueDropped++;
+			return;
+		}
+		else {
+			pos = logQueueTail.load(std::memory_order_relaxed);
+		}
+	}
+
+	safe_strncpy(slot->text,text,sizeof(slot->text));
+	slot->to_stderr = to_stderr;
+	slot->seq.store(pos + 1u,std::memory_order_release);
+
+	if (logWriterIdle.load(std::memory_order_acquire))
+		logWriterWake.notify_one();
+}
+
+static bool LOG_QueueEmpty(void) {
+	const size_t head = logQueueHead.load(std::memory_order_relaxed);
+	return logQueue[head & (LOG_QUEUE_SIZE - 1u)].seq.load(std::memory_order_acquire) != head + 1u;
+}
+
+static void LOG_WriterThread(void) {
+	unsigned int reported = 0;
+	bool to_stderr = false;
+
+	for (;;) {
+		bool wrote = false;
+
+		while (!LOG_QueueEmpty()) {
+			const size_t head = logQueueHead.load(std::memory_order_relaxed);
+			LogQueueSlot &slot = logQueue[head & (LOG_QUEUE_SIZE - 1u)];
+
+			LOG_WriteLine(slot.text,slot.to_stderr);
+			to_stderr |= slot.to_stderr;
+			slot.seq.store(head + LOG_QUEUE_SIZE,std::memory_order_release);
+			logQueueHead.store(head + 1u,std::memory_order_release);
+			wrote = true;
+		}
+
+		const unsigned int dropped = logQueueDropped.load();
+		if (dropped != reported) {
+			char tmp[96];
+			sprintf(tmp,"Logging: %u messages dropped, the log queue was full",dropped - reported);
+			LOG_WriteLine(tmp,to_stderr);
+			reported = dropped;
+			wrote = true;
+		}
+
+		if (wrote) {
+			LOG_FlushLines(to_stderr);
+			logQueueFlushed.store(logQueueHead.load());
+		}
+		else if (!logWriterRun.load())
+			break;
+
+		std::unique_lock<std::mutex> lock(logWriterMutex);
+		logWriterIdle.store(true);
+		if (LOG_QueueEmpty() && logWriterRun.load())
+			logWriterWake.wait_for(lock,std::chrono::milliseconds(20));
+		logWriterIdle.store(false);
+	}
+}
+
+static void LOG_StopWriter(void) {
+	if (logWriter == NULL) return;
+
+	logWriterRun.store(false);
+	logWriterWake.notify_one();
+	logWriter->join();
+	delete logWriter;
+	logWriter = NULL;
+}
+
+static void LOG_StartWriter(void) {
+#if C_EMSCRIPTEN
+	return; /* no threads, write as we go */
+#endif
+	if (logWriter != NULL) return;
+
+	for (size_t i = 0;i < LOG_QUEUE_SIZE;i++)
+		logQueue[i].seq.store(i);
+	logQueueTail.store(0);
+	logQueueHead.store(0);
+	logQueueFlushed.store(0);
+
+	logWriterRun.store(true);
+	logWriter = new std::thread(LOG_WriterThread);
+
+	/* exit() from anywhere must not leave lines in the queue */
+	static bool atexit_registered = false;
+	if (!atexit_registered) {
+		atexit(LOG_StopWriter);
+		atexit_registered = true;
+	}
+}
+
+/* wait until everything queued so far has been written */
+void LOG::Flush() {
+	if (logWriter == NULL) return;
+
+	const size_t tail = logQueueTail.load();
+	while ((ptrdiff_t)(logQueueFlushed.load() - tail) < 0) {
+		logWriterWake.notify_one();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
 bool IsDebuggerActive(void);
 
 void DEBUG_ShowMsg(char const* format,...) {
@@ -723,21 +900,13 @@ void DEBUG_ShowMsg(char const* format,...) {
 		stderrlog = true;
 #endif
 
-	if (debuglog != NULL) {
-		fprintf(debuglog,"%s\n",buf);
-		fflush(debuglog);
+	if (logWriter != NULL) {
+		if (debuglog != NULL || stderrlog)
+			LOG_Enqueue(buf,stderrlog);
 	}
-	if (stderrlog) {
-#if C_EMSCRIPTEN
-        /* Emscripten routes stderr to the browser console.error() function, and
-         * stdout to a console window below ours on the browser page. We want the
-         * user to see our blather, so print to stdout */
-		fprintf(stdout,"LOG: %s\n",buf);
-		fflush(stdout);
-#else
-		fprintf(stderr,"LOG: %s\n",buf);
-		fflush(stderr);
-#endif
+	else {
+		LOG_WriteLine(buf,stderrlog);
+		LOG_FlushLines(stderrlog);
 	}
 
 #if C_DEBUG
@@ -822,6 +991,8 @@ void DEBUG_ShowMsg(char const* format,...) {
 
 /* callback function when DOSBox-X exits */
 void LOG::Exit() {
+	LOG_StopWriter();
+
 	if (debuglog != NULL) {
 		if (log_dev_con != 2) fprintf(debuglog,"--END OF LOG--\n");
 		fclose(debuglog);
@@ -831,11 +1002,57 @@ void LOG::Exit() {
 
 void Null_Init(Section *sec);
 
+/* messages per second and category, "ratelimit" in [log] */
+struct LogRate {
+	uint64_t	second;
+	unsigned int	count;
+	unsigned int	dropped;	/* in this second */
+	unsigned int	total_dropped;
+};
+
+static LogRate logRate[LOG_MAX];
+
+static bool LOG_RateLimited(LOG_TYPES type) {
+	LogRate &rate = logRate[type];
+	const uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	if (rate.second != now) {
+		const unsigned int dropped = rate.dropped;
+
+		rate.second = now;
+		rate.count = 0;
+		rate.dropped = 0;
+		if (dropped != 0)
+			DEBUG_ShowMsg("Logging: %u %s messages dropped by the rate limit",dropped,loggrp[type].front);
+	}
+
+	if (rate.count >= log_ratelimit) {
+		rate.dropped++;
+		rate.total_dropped++;
+		return true;
+	}
+
+	rate.count++;
+	return false;
+}
+
+unsigned int LOG::Dropped(LOG_TYPES type) {
+	if (type == LOG_ALL) return logQueueDropped.load();
+	if (type >= LOG_MAX) return 0;
+	return logRate[type].total_dropped;
+}
+
 void LOG::operator() (char const* format, ...){
 	const char *s_severity = "";
 	char buf[512];
 	va_list msg;
 
+	/* decide first, most messages are filtered out and never need formatting */
+	if (d_type>=LOG_MAX) return;
+	if (d_severity < loggrp[d_type].min_severity) return;
+	if (log_ratelimit != 0 && LOG_RateLimited(d_type)) return;
+
 	switch (d_severity) {
 		case LOG_DEBUG:	s_severity = " DEBUG"; break;
 		case LOG_NORMAL:s_severity = "      "; break;
@@ -845,13 +1062,14 @@ void LOG::operator() (char const* format, ...){
 		default: break;
 	}
 
+	int len = snprintf(buf,sizeof(buf)-1,"%10u%s %s:",static_cast<uint32_t>(cycle_count),s_severity,loggrp[d_type].front);
+	if (len < 0 || len >= (int)sizeof(buf)-1) len = 0;
+
 	va_start(msg,format);
-	vsnprintf(buf,sizeof(buf)-1,format,msg);
+	vsnprintf(buf+len,sizeof(buf)-1u-(size_t)len,format,msg);
 	va_end(msg);
 
-	if (d_type>=LOG_MAX) return;
-	if (d_severity < loggrp[d_type].min_severity) return;
-	DEBUG_ShowMsg("%10u%s %s:%s\n",static_cast<uint32_t>(cycle_count),s_severity,loggrp[d_type].front,buf);
+	DEBUG_ShowMsg("%s",buf);
 }
 
 void LOG::ParseEnableSetting(_LogGroup &group,const char *setting) {
@@ -901,7 +1119,7 @@ void LOG::Init() {
 		ResolvePath(logfile);
 		if ((debuglog=fopen(logfile.c_str(),"wt+")) != NULL) {
 			LOG_MSG("Logging: opened logfile '%s' successfully. All further logging will go to this file.",logfile.c_str());
-			setbuf(debuglog,NULL);
+			if (!sect->Get_bool("async")) setbuf(debuglog,NULL); /* the writer thread flushes after each batch */
 		}
 		else {
 			LOG_MSG("Logging: failed to open logfile '%s'. All further logging will be discarded. Error: %s",logfile.c_str(),strerror(errno));
@@ -926,6 +1144,9 @@ void LOG::Init() {
 
     log_int21 = sect->Get_bool("int21") || control->opt_logint21;
     log_fileio = sect->Get_bool("fileio") || control->opt_logfileio;
+    log_ratelimit = (unsigned int)sect->Get_int("ratelimit");
+    log_async = sect->Get_bool("async");
+    if (log_async) LOG_StartWriter();
 
 	/* end of early init logging */
 	do_LOG_stderr = false;
@@ -1036,6 +1257,15 @@ void LOG::SetupConfigSection(void) {
     Pbool = sect->Add_bool("fileio",Property::Changeable::Always,false);
     Pbool->Set_help("Log file I/O through INT 21h");
 
+    Pbool = sect->Add_bool("async",Property::Changeable::OnlyAtStart,true);
+    Pbool->Set_help("Write the log file and console log from a background thread, so that verbose logging does not slow down emulation.\n"
+                    "If the background thread falls behind, messages are dropped and the number dropped is logged.");
+
+    Prop_int* Pint = sect->Add_int("ratelimit",Property::Changeable::OnlyAtStart,0);
+    Pint->SetMinMax(0,1000000);
+    Pint->Set_help("Maximum number of messages per second from one log category. Messages over the limit are dropped and the\n"
+                   "number dropped is logged. 0 means no limit.");
+
 	const char* debuggerrunopt[] = { "debugger", "normal", "watch", nullptr };
 	Pstring = sect->Add_string("debuggerrun",Property::Changeable::OnlyAtStart,"debugger");
 	Pstring->Set_help("The run mode when the DOSBox-X Debugger starts.");
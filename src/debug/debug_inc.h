@@ -117,6 +117,7 @@ extern DBGBlock dbg;
 
 /* Local Debug Stuff */
 Bitu DasmI386(char* buffer, PhysPt pc, uint32_t cur_ip, bool bit32);
+Bitu DasmI386Code(char* buffer, const uint8_t* code, Bitu code_len, uint32_t cur_ip, bool bit32);
 int  DasmLastOperandSize(void);
 #endif
 
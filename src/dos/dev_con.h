@@ -60,6 +60,7 @@ static bool pc98_column_over;
 extern bool CheckHat(uint8_t code);
 extern bool isDBCSCP();
 extern bool inshell;
+extern RealPt GetSystemBiosINT10Vector(void);
 #if defined(USE_TTF)
 extern bool ttf_dosv;
 #endif
@@ -100,6 +101,7 @@ public:
 private:
 	void ClearAnsi(void);
 	void Output(uint8_t chr);
+	uint16_t OutputRun(const uint8_t * data,uint16_t len);
 	uint8_t readcache;
 	bool lasthat;
 	struct ansi { /* should create a constructor, which would fill them with the appropriate values */
@@ -1066,6 +1068,7 @@ extern bool ctrlbrk;
 extern int log_dev_con;
 std::string log_dev_con_str;
 bool logging_con = false;
+Bitu dev_con_run_chars = 0; /* characters written by OutputRun(), for the tests */
 bool DOS_BreakTest(bool print);
 void DOS_BreakAction();
 bool read_kanji1 = false;
@@ -1193,6 +1196,11 @@ bool device_CON::Write(const uint8_t * data,uint16_t * size) {
             } else if (data[count] == 0x1E && IS_PC98_ARCH) {
                 Real_INT10_SetCursorPos(0,0,page);
             } else { 
+                const uint16_t run = OutputRun(data+count,*size-count);
+                if (run != 0) {
+                    count += run;
+                    continue;
+                }
                 Output(data[count]);
                 count++;
                 continue;
@@ -1699,6 +1707,67 @@ void device_CON::Output(uint8_t chr) {
 	} else Real_INT10_TeletypeOutput(chr,DefaultANSIAttr());
 }
 
+/* Characters Output() hands to Real_INT10_TeletypeOutputAttr() to be drawn as they are */
+static inline bool ConRunChar(const uint8_t chr) {
+	switch (chr) {
+		case 7: case 8: case '\t': case '\n': case '\r': case '\033':
+			return false;
+		default:
+			return true;
+	}
+}
+
+/* INT 10h still ends up in our own BIOS, either directly or through a JMP FAR such as the VGA BIOS entry point */
+static bool ConINT10IsBIOS(void) {
+	const RealPt biosint10 = GetSystemBiosINT10Vector();
+	const RealPt vec = RealGetVec(0x10);
+
+	if (biosint10 == 0) return false;
+	if (vec == biosint10) return true;
+	return real_readb(RealSeg(vec),RealOff(vec)) == 0xEA && real_readd(RealSeg(vec),RealOff(vec)+1) == biosint10;
+}
+
+/* Write a run of plain characters straight into text mode video memory and move the cursor once at the end.
+ * This is only done where the result is exactly what Output() would give going through INT 10h for each
+ * character: ANSI output in a text mode with INT 10h still pointing at our own BIOS. Returns the number of
+ * characters written, 0 if the caller should use Output() instead. */
+uint16_t device_CON::OutputRun(const uint8_t * data,uint16_t len) {
+	if (IS_PC98_ARCH || log_dev_con || isDBCSCP() || J3_IsJapanese()) return 0;
+	if (!ANSI_SYS_installed() || !(dos.internal_output || ansi.enabled)) return 0;
+	if (CurMode->type != M_TEXT || !ConINT10IsBIOS()) return 0;
+
+	const uint8_t page = real_readb(BIOSMEM_SEG,BIOSMEM_CURRENT_PAGE);
+	const uint16_t pageofs = page*real_readw(BIOSMEM_SEG,BIOSMEM_PAGE_SIZE);
+	uint8_t col = CURSOR_POS_COL(page);
+	uint8_t row = CURSOR_POS_ROW(page);
+	BIOS_NCOLS;BIOS_NROWS;
+
+	if (nrows < 2 || col >= ncols || row >= nrows) return 0;
+
+	uint16_t count = 0;
+	while (count < len && ConRunChar(data[count])) {
+		/* same as Output(): scroll before writing the last cell of the screen */
+		if (row == nrows-1 && col == ncols-1) {
+			INT10_ScrollWindow(0,0,(uint8_t)(nrows-1),(uint8_t)(ncols-1),-1,ansi.attr,page);
+			row--;
+		}
+
+		const uint16_t address = pageofs+(row*ncols+col)*2;
+		mem_writeb(CurMode->pstart+address,data[count]);
+		mem_writeb(CurMode->pstart+address+1,ansi.attr);
+
+		if (++col == ncols) {
+			col = 0;
+			row++;
+		}
+		count++;
+	}
+
+	if (count != 0) INT10_SetCursorPos(row,col,page);
+	dev_con_run_chars += count;
+	return count;
+}
+
 bool device_CON::ANSI_SYS_installed() {
     return ansi.installed;
 }
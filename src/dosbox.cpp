@@ -99,6 +99,7 @@ struct __processor_model {
 #include <windows.h>
 #endif
 
+#include <chrono>
 #include <list>
 
 bool int10_vp_use_always = false;
@@ -316,6 +317,10 @@ static uint32_t           Ticks = 0;
 extern double           rtdelta;
 static LoopHandler*     loop;
 
+bool                    benchmark_mode = false;
+unsigned long long      benchmark_instruction_limit = 0;
+unsigned long long      benchmark_frames = 0;
+
 void increaseticks(), makestdcp950table(), makeseacp951table();
 
 /* The whole load of startups for all the subfunctions */
@@ -428,6 +433,146 @@ extern bool DOSBox_Paused(), isDBCSCP(), InitCodePage();
 
 static Uint32 SDL_ticks_last = 0,SDL_ticks_next = 0;
 
+/* Benchmark accounting. Cycles are what the core took off CPU_Cycles, instructions
+ * are those cycles less the ones I/O delay and HLT threw away. Every core charges
+ * one cycle per instruction otherwise. */
+enum {
+    BENCH_CORE_NORMAL=0,
+    BENCH_CORE_SIMPLE,
+    BENCH_CORE_FULL,
+    BENCH_CORE_PREFETCH,
+    BENCH_CORE_DYNAMIC,
+    BENCH_CORE_HALT,
+    BENCH_CORE_OTHER,
+    BENCH_CORE_MAX
+};
+
+static const char* const benchmark_core_names[BENCH_CORE_MAX] = {
+    "normal", "simple", "full", "prefetch", "dynamic", "halt", "other"
+};
+
+static struct {
+    bool started;
+    std::chrono::steady_clock::time_point start;
+    Bitu start_ticks;
+    unsigned long long start_samples;
+    unsigned long long instructions;
+    unsigned long long cycles[BENCH_CORE_MAX];
+    unsigned long long core_instructions[BENCH_CORE_MAX];
+    double seconds[BENCH_CORE_MAX];
+} benchmark;
+
+extern unsigned long long mixer_sample_counter;
+extern Bitu time_limit_ms;
+Bits HLT_Decode(void);
+
+static unsigned int DOSBOX_BenchmarkCore(CPU_Decoder *decoder) {
+    if (decoder == &CPU_Core_Normal_Run || decoder == &CPU_Core_Normal_Trap_Run ||
+        decoder == &CPU_Core286_Normal_Run || decoder == &CPU_Core286_Normal_Trap_Run ||
+        decoder == &CPU_Core8086_Normal_Run || decoder == &CPU_Core8086_Normal_Trap_Run)
+        return BENCH_CORE_NORMAL;
+    if (decoder == &CPU_Core_Prefetch_Run || decoder == &CPU_Core_Prefetch_Trap_Run ||
+        decoder == &CPU_Core286_Prefetch_Run || decoder == &CPU_Core8086_Prefetch_Run)
+        return BENCH_CORE_PREFETCH;
+    if (decoder == &HLT_Decode)
+        return BENCH_CORE_HALT;
+#if !defined(C_EMSCRIPTEN)
+    if (decoder == &CPU_Core_Simple_Run || decoder == &CPU_Core_Simple_Trap_Run)
+        return BENCH_CORE_SIMPLE;
+    if (decoder == &CPU_Core_Full_Run)
+        return BENCH_CORE_FULL;
+#endif
+#if C_DYNAMIC_X86
+    if (decoder == &CPU_Core_Dyn_X86_Run || decoder == &CPU_Core_Dyn_X86_Trap_Run)
+        return BENCH_CORE_DYNAMIC;
+#endif
+#if C_DYNREC
+    if (decoder == &CPU_Core_Dynrec_Run || decoder == &CPU_Core_Dynrec_Trap_Run)
+        return BENCH_CORE_DYNAMIC;
+#endif
+    return BENCH_CORE_OTHER;
+}
+
+void DOSBOX_BenchmarkReset(void) {
+    memset(benchmark.cycles,0,sizeof(benchmark.cycles));
+    memset(benchmark.core_instructions,0,sizeof(benchmark.core_instructions));
+    for (unsigned int i=0;i < BENCH_CORE_MAX;i++) benchmark.seconds[i] = 0;
+    benchmark.instructions = 0;
+    benchmark_frames = 0;
+    benchmark.started = false;
+}
+
+/* run the CPU core once, and charge what it did to it */
+static Bits DOSBOX_BenchmarkDecoder(void) {
+    if (!benchmark.started) {
+        benchmark.started = true;
+        benchmark.start = std::chrono::steady_clock::now();
+        benchmark.start_ticks = PIC_Ticks;
+        benchmark.start_samples = mixer_sample_counter;
+    }
+
+    const unsigned int core = DOSBOX_BenchmarkCore(cpudecoder);
+    const cpu_cycles_count_t before = CPU_Cycles + CPU_CycleLeft;
+    const cpu_cycles_count_t removed = CPU_IODelayRemoved;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    const Bits ret = (*cpudecoder)();
+
+    const cpu_cycles_count_t cycles = before - (CPU_Cycles + CPU_CycleLeft);
+    const cpu_cycles_count_t instructions = cycles - (CPU_IODelayRemoved - removed);
+    benchmark.seconds[core] += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (cycles > 0) benchmark.cycles[core] += (unsigned long long)cycles;
+    if (instructions > 0) {
+        benchmark.core_instructions[core] += (unsigned long long)instructions;
+        benchmark.instructions += (unsigned long long)instructions;
+    }
+
+    return ret;
+}
+
+unsigned long long DOSBOX_BenchmarkInstructions(void) {
+    return benchmark.instructions;
+}
+
+std::string DOSBOX_BenchmarkReport(void) {
+    const double seconds = benchmark.started ?
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - benchmark.start).count() : 0;
+    const Bitu emulated_ms = benchmark.started ? PIC_Ticks - benchmark.start_ticks : 0;
+    const unsigned long long samples = benchmark.started ? mixer_sample_counter - benchmark.start_samples : 0;
+    unsigned long long cycles = 0;
+    for (unsigned int i=0;i < BENCH_CORE_MAX;i++) cycles += benchmark.cycles[i];
+
+    const char *stop = "exit";
+    if (benchmark_instruction_limit != 0 && benchmark.instructions >= benchmark_instruction_limit)
+        stop = "instructions";
+    else if (time_limit_ms != 0 && PIC_Ticks >= time_limit_ms)
+        stop = "time";
+
+    std::string r = "{\n";
+    r += formatString("  \"version\": \"%s\",\n",VERSION);
+    r += formatString("  \"stop\": \"%s\",\n",stop);
+    r += formatString("  \"host_seconds\": %.6f,\n",seconds);
+    r += formatString("  \"emulated_ms\": %llu,\n",(unsigned long long)emulated_ms);
+    r += formatString("  \"cycles_per_ms\": %lld,\n",(long long)CPU_CycleMax);
+    r += formatString("  \"instructions\": %llu,\n",benchmark.instructions);
+    r += formatString("  \"cycles\": %llu,\n",cycles);
+    r += formatString("  \"instructions_per_host_second\": %.0f,\n",seconds > 0 ? benchmark.instructions / seconds : 0.0);
+    r += formatString("  \"cycles_per_host_second\": %.0f,\n",seconds > 0 ? cycles / seconds : 0.0);
+    r += formatString("  \"frames\": %llu,\n",benchmark_frames);
+    r += formatString("  \"audio_samples\": %llu,\n",samples);
+    r += "  \"cores\": {";
+    bool first = true;
+    for (unsigned int i=0;i < BENCH_CORE_MAX;i++) {
+        if (benchmark.cycles[i] == 0 && benchmark.seconds[i] == 0) continue;
+        r += formatString("%s\n    \"%s\": { \"instructions\": %llu, \"cycles\": %llu, \"host_seconds\": %.6f }",
+            first ? "" : ",",benchmark_core_names[i],benchmark.core_instructions[i],benchmark.cycles[i],benchmark.seconds[i]);
+        first = false;
+    }
+    r += first ? "}\n" : "\n  }\n";
+    r += "}\n";
+    return r;
+}
+
 static Bitu Normal_Loop(void) {
     bool saved_allow = dosbox_allow_nonrecursive_page_fault;
     Bits ret;
@@ -469,9 +614,17 @@ static Bitu Normal_Loop(void) {
                 /* now is the time to check for the NMI (Non-maskable interrupt) */
                 CPU_Check_NMI();
 
+#if C_HEAVY_DEBUG
+                /* callbacks, PIC events and DMA may have written memory without going through the page handlers */
+                DEBUG_HeavyMemoryChanged();
+#endif
+
                 saved_allow = dosbox_allow_nonrecursive_page_fault;
                 dosbox_allow_nonrecursive_page_fault = true;
-                ret = (*cpudecoder)();
+                if (GCC_UNLIKELY(benchmark_mode))
+                    ret = DOSBOX_BenchmarkDecoder();
+                else
+                    ret = (*cpudecoder)();
                 dosbox_allow_nonrecursive_page_fault = saved_allow;
 
                 if (GCC_UNLIKELY(ret<0))
@@ -565,7 +718,7 @@ static Bitu Normal_Loop(void) {
 void increaseticks() { //Make it return ticksRemain and set it in the function above to remove the global variable.
     static int32_t lastsleepDone = -1;
     static Bitu sleep1count = 0;
-    if (GCC_UNLIKELY(ticksLocked)) { // For Fast Forward Mode
+    if (GCC_UNLIKELY(ticksLocked || benchmark_mode)) { // For Fast Forward Mode, and benchmarks which never wait
         ticksRemainSpeedFrac = 0;
         ticksRemain = 5;
         /* Reset any auto cycle guessing for this frame */
@@ -3022,6 +3175,13 @@ void DOSBOX_SetupConfigSections(void) {
                       "In addition to the render on demand option, this option may further break timing dependent effects and/or cause problems with some games.");
     Pstring->SetBasic(true);
 
+    Pbool = secprop->Add_bool("skip unchanged scanlines",Property::Changeable::OnlyAtStart,false);
+    Pbool->Set_help("If set, writes to video memory are tracked per 4KB page, and scanlines of SVGA linear (8/15/16/24/32bpp) modes\n"
+                    "whose video memory and palette did not change since the last frame are not converted and compared again.\n"
+                    "This may provide a performance benefit for mostly static SVGA desktops and menus. Writes to the linear\n"
+                    "framebuffer can no longer be mapped directly to video memory, which costs some performance in games that\n"
+                    "redraw the whole screen every frame.");
+
     Pstring = secprop->Add_string("scanline render on demand",Property::Changeable::Always,"auto");
     Pstring->Set_values(truefalseautoopt);
     Pstring->Set_help("Render video output at vsync or when something is changed mid frame, instead of stopping to render every scanline.\n"
@@ -4361,8 +4521,9 @@ void DOSBOX_SetupConfigSections(void) {
         "                 (realport:COM1 realport:ttyS0).\n"
         "for modem: listenport (optional).\n"
         "for nullmodem: server, rxdelay, txdelay, telnet, usedtr,\n"
-        "               transparent, port, inhsocket, sock, nonlocal (all optional).\n"
+        "               transparent, port, inhsocket, sock, nonlocal, unthrottled (all optional).\n"
         "               connections are limited to localhost unless you specify nonlocal:1\n"
+        "               unthrottled:1 ignores the baud rate and moves data as fast as the program can take it.\n"
         "               \"sock\" parameter specifies the protocol to be used by both sides\n"
         "               of the connection. 0 for TCP and 1 for ENet reliable UDP.\n"
         "Example: serial1=modem listenport:5000 sock:1\n"
@@ -5154,6 +5315,10 @@ void DOSBOX_SetupConfigSections(void) {
     Pstring->Set_values(backendopts);
     Pstring->SetBasic(true);
 
+    Pbool = secprop->Add_bool("nicthread", Property::Changeable::WhenIdle, true);
+    Pbool->Set_help("Poll the backend and send packets from a separate network thread, instead of once per emulated millisecond\n"
+                    "from the emulation thread. Received packets are still passed to the NE2000 on the emulation thread.");
+
     secprop = control->AddSection_prop("ethernet, pcap", &Null_Init, true);
 
     Pstring = secprop->Add_string("realnic", Property::Changeable::WhenIdle,"list");
@@ -5286,6 +5451,13 @@ void DOSBOX_SetupConfigSections(void) {
                 "In this way, you can have DOSBox-X emulate one of the strange quirks of 1995-1997 era\n"
                 "laptop hardware");
 
+        Pbool = secprop->Add_bool("bus master dma",Property::Changeable::OnlyAtStart,false);
+        if (i == 0) Pbool->Set_help(
+                "If set, and the PCI bus is enabled, the interface is attached to an emulated PCI bus master IDE\n"
+                "function (Intel PIIX3) and the drives will accept READ/WRITE DMA and ATAPI DMA commands.\n"
+                "Guest drivers that support bus master IDE then move whole blocks per transfer instead of\n"
+                "one word per I/O. Only the primary and secondary interfaces can use bus master DMA.");
+
         Pint = secprop->Add_int("cd-rom spinup time",Property::Changeable::WhenIdle,0/*use IDE or CD-ROM default*/);
         if (i == 0) Pint->Set_help("Emulated CD-ROM time in ms to spin up if CD is stationary.\n"
                 "Set to 0 to use controller or CD-ROM drive-specific default.");
@@ -36,6 +36,9 @@
 #include <semaphore.h>
 #endif // WIN32
 
+#include <atomic>
+#include <vector>
+
 // SDL Dependencies
 #include "SDL_syswm.h"
 #include "SDL.h"
@@ -52,6 +55,7 @@ extern uint32_t RunningProgramLoadAddress;
 #define SYSTEM_NAME		"DOSBox"
 
 #define PROTOCOL_VER		4
+#define PROTOCOL_VER_RING	5 // frames go through the frame ring
 
 #ifdef WIN32
 #define GAMELINK_MUTEX_NAME		"DWD_GAMELINK_MUTEX_R4"
@@ -65,6 +69,12 @@ extern uint32_t RunningProgramLoadAddress;
 #define GAMELINK_MMAP_NAME		"DWD_GAMELINK_MMAP_R4"
 #endif // MACOSX
 
+#ifdef MACOSX
+#define GAMELINK_FRAMES_NAME	"/DWD_GAMELINK_FRAMES_R5"
+#else // MACOSX
+#define GAMELINK_FRAMES_NAME	"DWD_GAMELINK_FRAMES_R5"
+#endif // MACOSX
+
 
 //------------------------------------------------------------------------------
 // Local Data
@@ -74,11 +84,13 @@ extern uint32_t RunningProgramLoadAddress;
 
 static HANDLE g_mutex_handle;
 static HANDLE g_mmap_handle;
+static HANDLE g_frames_handle;
 
 #else // WIN32
 
 static sem_t* g_mutex_handle;
 static int g_mmap_handle; // fd!
+static int g_frames_handle = -1; // fd!
 
 #endif // WIN32
 
@@ -88,7 +100,15 @@ static uint32_t g_membase_size;
 
 static GameLink::sSharedMemoryMap_R4* g_p_shared_memory;
 
+// Protocol v5 frame ring, NULL when frames go to the memory map.
+static GameLink::sSharedMMapFrames_R5* g_p_frames;
+
+static uint32_t g_frame_count; // frames put in the ring
+static std::vector< uint32_t > g_line_frame; // frame number each line last changed in
+static uint32_t g_changed_count; // lines changed since the last frame put in the ring
+
 #define MEMORY_MAP_CORE_SIZE sizeof( GameLink::sSharedMemoryMap_R4 )
+#define FRAMES_MAP_SIZE sizeof( GameLink::sSharedMMapFrames_R5 )
 
 
 //------------------------------------------------------------------------------
@@ -101,7 +121,7 @@ static void shared_memory_init()
 
 	// Initialise
 
-	g_p_shared_memory->version = PROTOCOL_VER;
+	g_p_shared_memory->version = g_p_frames ? PROTOCOL_VER_RING : PROTOCOL_VER;
 	g_p_shared_memory->flags = 0;
 
 	memset( g_p_shared_memory->system, 0, sizeof( g_p_shared_memory->system ) );
@@ -360,6 +380,217 @@ static void destroy_shared_memory()
 
 }
 
+//
+// create_frame_ring
+//
+// Create the shared memory area for the protocol v5 frame ring.
+//
+// \returns 1 if we made one, 0 if it failed.
+//
+static int create_frame_ring()
+{
+	GameLink::sSharedMMapFrames_R5* p_frames = NULL;
+
+#ifdef WIN32
+
+	const uint64_t size = FRAMES_MAP_SIZE;
+	g_frames_handle = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL,
+			PAGE_READWRITE, (DWORD)( size >> 32 ), (DWORD)size, GAMELINK_FRAMES_NAME );
+
+	if ( g_frames_handle )
+	{
+		p_frames = reinterpret_cast< GameLink::sSharedMMapFrames_R5* >(
+			MapViewOfFile( g_frames_handle, FILE_MAP_ALL_ACCESS, 0, 0, FRAMES_MAP_SIZE )
+			);
+
+		if ( p_frames == NULL )
+		{
+			CloseHandle( g_frames_handle );
+			g_frames_handle = NULL;
+		}
+	}
+
+#else // WIN32
+
+	g_frames_handle = shm_open( GAMELINK_FRAMES_NAME, O_CREAT
+#ifndef MACOSX
+								| O_TRUNC
+#endif // !MACOSX
+								| O_RDWR, 0666 );
+
+	if ( g_frames_handle < 0 )
+	{
+		LOG_MSG( "GAMELINK: shm_open( \"" GAMELINK_FRAMES_NAME "\" ) failed. errno = %d", errno );
+	}
+	else if ( ftruncate( g_frames_handle, FRAMES_MAP_SIZE ) < 0 )
+	{
+		LOG_MSG( "GAMELINK: ftruncate failed. errno = %d", errno );
+		close( g_frames_handle );
+		g_frames_handle = -1;
+		shm_unlink( GAMELINK_FRAMES_NAME );
+	}
+	else
+	{
+		// Pages the frames do not reach are never touched, so they cost no memory.
+		void* p = mmap( nullptr, FRAMES_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, g_frames_handle, 0 );
+		if ( p == MAP_FAILED )
+		{
+			LOG_MSG( "GAMELINK: mmap failed. errno = %d", errno );
+			close( g_frames_handle );
+			g_frames_handle = -1;
+			shm_unlink( GAMELINK_FRAMES_NAME );
+		}
+		else
+		{
+			p_frames = reinterpret_cast< GameLink::sSharedMMapFrames_R5* >( p );
+		}
+	}
+
+#endif // WIN32
+
+	if ( p_frames == NULL )
+	{
+		return 0;
+	}
+
+	// Blank ring, the slot headers only. A slot with no frame has image_fmt 0.
+	p_frames->version = PROTOCOL_VER_RING;
+	p_frames->latest = 0;
+	p_frames->slot_count = GameLink::sSharedMMapFrames_R5::SLOT_COUNT;
+	p_frames->slot_size = sizeof( GameLink::sSharedMMapFrameSlot_R5 );
+	for ( uint32_t i = 0; i < GameLink::sSharedMMapFrames_R5::SLOT_COUNT; ++i )
+	{
+		GameLink::sSharedMMapFrameSlot_R5& slot = p_frames->slot[ i ];
+		slot.seq = 0;
+		slot.frame = 0;
+		slot.width = 0;
+		slot.height = 0;
+		slot.image_fmt = 0;
+		slot.par_x = 1;
+		slot.par_y = 1;
+		slot.changed_count = 0;
+	}
+
+	g_p_frames = p_frames;
+	g_frame_count = 0;
+	g_changed_count = 0;
+	g_line_frame.clear();
+
+	return 1;
+}
+
+//
+// destroy_frame_ring
+//
+// Destroy the frame ring shared memory area.
+//
+static void destroy_frame_ring()
+{
+#ifdef WIN32
+
+	if ( g_p_frames )
+	{
+		UnmapViewOfFile( g_p_frames );
+		g_p_frames = NULL;
+	}
+
+	if ( g_frames_handle )
+	{
+		CloseHandle( g_frames_handle );
+		g_frames_handle = NULL;
+	}
+
+#else // WIN32
+
+	if ( g_p_frames )
+	{
+		munmap( g_p_frames, FRAMES_MAP_SIZE );
+		g_p_frames = NULL;
+
+		shm_unlink( GAMELINK_FRAMES_NAME );
+	}
+
+	if ( g_frames_handle >= 0 )
+	{
+		close( g_frames_handle );
+		g_frames_handle = -1;
+	}
+
+#endif // WIN32
+}
+
+//
+// publish_frame
+//
+// Write a frame to the ring slot after the latest one and make it the latest.
+// Only lines that changed since the frame the slot held are copied.
+//
+static void publish_frame( const uint16_t frame_width,
+						   const uint16_t frame_height,
+						   const uint16_t par_x,
+						   const uint16_t par_y,
+						   const uint8_t* p_frame )
+{
+	if ( frame_width > GameLink::sSharedMMapFrameSlot_R5::MAX_WIDTH ||
+		 frame_height > GameLink::sSharedMMapFrameSlot_R5::MAX_HEIGHT ) {
+		return;
+	}
+
+	const uint32_t frame = g_frame_count + 1;
+
+	if ( g_line_frame.size() != frame_height ) {
+		g_line_frame.assign( frame_height, frame );
+		g_changed_count = frame_height;
+	}
+
+	const uint32_t latest = *( volatile uint32_t* )&( g_p_frames->latest );
+	GameLink::sSharedMMapFrameSlot_R5& last = g_p_frames->slot[ latest ];
+
+	// Nothing new? Clients already have this.
+	if ( g_changed_count == 0 && last.image_fmt == 1 && last.width == frame_width &&
+		 last.height == frame_height && last.par_x == par_x && last.par_y == par_y ) {
+		return;
+	}
+
+	const uint32_t index = ( latest + 1 ) % GameLink::sSharedMMapFrames_R5::SLOT_COUNT;
+	GameLink::sSharedMMapFrameSlot_R5& slot = g_p_frames->slot[ index ];
+	volatile uint32_t* p_seq = &slot.seq;
+
+	// Open the slot. Clients that see an odd sequence number skip it.
+	const uint32_t seq = *p_seq;
+	*p_seq = seq + 1;
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+
+	const bool same_size = slot.image_fmt == 1 && slot.width == frame_width && slot.height == frame_height;
+	const uint32_t slot_frame = same_size ? slot.frame : 0;
+	const size_t pitch = (size_t)frame_width * 4;
+
+	for ( uint16_t y = 0; y < frame_height; ++y )
+	{
+		if ( g_line_frame[ y ] > slot_frame ) {
+			memcpy( slot.buffer + y * pitch, p_frame + y * pitch, pitch );
+		}
+		slot.line_frame[ y ] = g_line_frame[ y ];
+	}
+
+	slot.frame = frame;
+	slot.width = frame_width;
+	slot.height = frame_height;
+	slot.image_fmt = 1; // = 32-bit RGBA
+	slot.par_x = par_x;
+	slot.par_y = par_y;
+	slot.changed_count = g_changed_count;
+
+	// Close the slot and publish it.
+	std::atomic_thread_fence( std::memory_order_release );
+	*p_seq = seq + 2;
+	std::atomic_thread_fence( std::memory_order_release );
+	*( volatile uint32_t* )&( g_p_frames->latest ) = index;
+
+	g_frame_count = frame;
+	g_changed_count = 0;
+}
+
 //==============================================================================
 
 //------------------------------------------------------------------------------
@@ -418,6 +649,15 @@ uint8_t* GameLink::AllocRAM( const uint32_t size )
 		return nullptr;
 	}
 
+	// Frames through the ring?
+	if ( sdl.gamelink.protocol >= PROTOCOL_VER_RING && !sdl.gamelink.snoop && !g_trackonly_mode )
+	{
+		if ( create_frame_ring() != 1 )
+		{
+			LOG_MSG( "GAMELINK: Couldn't create the frame ring, using protocol v%d.", PROTOCOL_VER );
+		}
+	}
+
 	// Initialise
 	shared_memory_init();
 
@@ -425,6 +665,9 @@ uint8_t* GameLink::AllocRAM( const uint32_t size )
 
 	const int memory_map_size = MEMORY_MAP_CORE_SIZE + g_membase_size;
 	LOG_MSG( "GAMELINK: Initialised. Allocated %d MB of shared memory.", (memory_map_size + (1024*1024) - 1) / (1024*1024) );
+	if ( g_p_frames )
+		LOG_MSG( "GAMELINK: Protocol v%d, frames up to %dx%d.", PROTOCOL_VER_RING,
+			GameLink::sSharedMMapFrameSlot_R5::MAX_WIDTH, GameLink::sSharedMMapFrameSlot_R5::MAX_HEIGHT );
 
 	if (sdl.gamelink.snoop) {
 		membase = (uint8_t*)malloc(g_membase_size);
@@ -454,7 +697,10 @@ void GameLink::Term()
 	// SEND ABORT CODE TO CLIENT (don't care if it fails)
 	if (!sdl.gamelink.snoop && g_p_shared_memory)
 		g_p_shared_memory->version = 0;
+	if ( g_p_frames )
+		g_p_frames->version = 0;
 
+	destroy_frame_ring();
 	destroy_shared_memory();
 
 	destroy_mutex( GAMELINK_MUTEX_NAME );
@@ -505,6 +751,53 @@ int GameLink::In( GameLink::sSharedMMapInput_R2* p_input,
 	return ready;
 }
 
+//------------------------------------------------------------------------------
+// GameLink::Changed
+//------------------------------------------------------------------------------
+void GameLink::Changed( const uint16_t* p_changed_lines,
+						const uint16_t frame_height )
+{
+	if ( g_p_frames == NULL ) {
+		return; // <=== EARLY OUT
+	}
+
+	// Lines changed now are part of the next frame put in the ring.
+	const uint32_t frame = g_frame_count + 1;
+
+	if ( g_line_frame.size() != frame_height ) {
+		g_line_frame.assign( frame_height, frame );
+		g_changed_count = frame_height;
+		return;
+	}
+
+	if ( p_changed_lines == NULL ) {
+		// everything
+		for ( uint16_t y = 0; y < frame_height; ++y ) {
+			if ( g_line_frame[ y ] != frame ) {
+				g_line_frame[ y ] = frame;
+				++g_changed_count;
+			}
+		}
+		return;
+	}
+
+	// Alternating runs of unchanged and changed lines, as passed to GFX_EndUpdate.
+	uint32_t y = 0;
+	for ( uint32_t index = 0; y < frame_height; ++index )
+	{
+		const uint32_t run = p_changed_lines[ index ];
+		if ( index & 1 ) {
+			for ( uint32_t i = y; i < y + run && i < frame_height; ++i ) {
+				if ( g_line_frame[ i ] != frame ) {
+					g_line_frame[ i ] = frame;
+					++g_changed_count;
+				}
+			}
+		}
+		y += run;
+	}
+}
+
 //------------------------------------------------------------------------------
 // GameLink::Out
 //------------------------------------------------------------------------------
@@ -560,6 +853,11 @@ void GameLink::Out( const uint16_t frame_width,
 	//
 	// Send data?
 
+	// Frame ring? Clients never hold it up, so write it outside the mutex.
+	if ( g_p_frames && !g_trackonly_mode ) {
+		publish_frame( frame_width, frame_height, par_x, par_y, p_frame );
+	}
+
 	// Message buffer
 	sSharedMMapBuffer_R1 proc_mech_buffer;
 	proc_mech_buffer.payload = 0;
@@ -587,7 +885,7 @@ void GameLink::Out( const uint16_t frame_width,
 		if (!sdl.gamelink.snoop) {
 
 			// Set version
-			g_p_shared_memory->version = PROTOCOL_VER;
+			g_p_shared_memory->version = g_p_frames ? PROTOCOL_VER_RING : PROTOCOL_VER;
 
 			// Set program
 			strncpy( g_p_shared_memory->program, p_program, 256 );
@@ -599,7 +897,7 @@ void GameLink::Out( const uint16_t frame_width,
 			// Store flags
 			g_p_shared_memory->flags = flags;
 
-			if ( g_trackonly_mode == false )
+			if ( g_trackonly_mode == false && g_p_frames == NULL )
 			{
 				// Update the frame sequence
 				++g_p_shared_memory->frame.seq;
@@ -48,6 +48,57 @@ namespace GameLink
 		uint8_t buffer[ MAX_PAYLOAD ];
 	};
 
+	//
+	// sSharedMMapFrameSlot_R5
+	//
+	// One frame of the protocol v5 frame ring. 32-bit RGBA up to MAX_WIDTH x MAX_HEIGHT
+	//
+	struct sSharedMMapFrameSlot_R5
+	{
+		uint32_t seq; // odd while the server writes the slot
+		uint32_t frame; // frame number, counts up from 1
+
+		uint16_t width;
+		uint16_t height;
+
+		uint8_t image_fmt; // 0 = no frame; 1 = 32-bit 0xAARRGGBB
+		uint8_t reserved0;
+
+		uint16_t par_x; // pixel aspect ratio
+		uint16_t par_y;
+		uint16_t reserved1;
+
+		uint32_t changed_count; // lines that changed in this frame
+
+		enum { MAX_WIDTH = 3840 };
+		enum { MAX_HEIGHT = 2400 };
+
+		enum { MAX_PAYLOAD = MAX_WIDTH * MAX_HEIGHT * 4 };
+		uint32_t line_frame[ MAX_HEIGHT ]; // frame number each line last changed in
+		uint8_t buffer[ MAX_PAYLOAD ];
+	};
+
+	//
+	// sSharedMMapFrames_R5
+	//
+	// Server -> Client frame ring (protocol v5), mapped separately from the
+	// memory map. The server fills the slot after "latest" and then points
+	// "latest" at it, so it never waits for a client. A client copies the
+	// slot at "latest" and starts over if "seq" was odd or changed while it
+	// copied. A client that kept the frame numbered N only needs the lines
+	// whose line_frame is above N.
+	//
+	struct sSharedMMapFrames_R5
+	{
+		enum { SLOT_COUNT = 3 };
+
+		uint32_t version; // = 5
+		uint32_t latest; // slot with the newest complete frame
+		uint32_t slot_count;
+		uint32_t slot_size; // bytes per slot
+		sSharedMMapFrameSlot_R5 slot[ SLOT_COUNT ];
+	};
+
 	//
 	// sSharedMMapInput_R2
 	//
@@ -156,6 +207,9 @@ namespace GameLink
 	extern int In( sSharedMMapInput_R2* p_input,
 				   sSharedMMapAudio_R1* p_audio );
 
+	extern void Changed( const uint16_t* p_changed_lines,
+						 const uint16_t frame_height );
+
 	extern void Out( const uint16_t frame_width,
 					 const uint16_t frame_height,
 					 const double source_ratio,
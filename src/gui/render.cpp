@@ -380,6 +380,36 @@ static void RENDER_FinishLineHandler(const void * s) {
 }
 
 
+/* Called by the VGA emulation in place of RENDER_DrawLine when it knows that the next scanline
+ * is identical to what was rendered there last frame, so that it need not convert the line at all.
+ * Returns false if the renderer is in a state where it needs the actual line (cache clear, palette
+ * change, direct output), in which case the caller must draw the line normally. */
+bool RENDER_DrawLineUnchanged(void) {
+    if (render.disablerender)
+        return true;
+
+    if (RENDER_DrawLine == RENDER_StartLineHandler) {
+        render.scale.cacheRead += render.scale.cachePitch;
+        Scaler_ChangedLines[0] += Scaler_Aspect[ render.scale.inLine ];
+        render.scale.inLine++;
+        render.scale.outLine++;
+        return true;
+    }
+
+    /* once the scaler is running, hand it the cached copy of the line. it finds no difference and
+     * only does its usual bookkeeping, which is still far cheaper than converting from video memory */
+    if (RENDER_DrawLine == RENDER_ScalerLineHandler
+#if defined(C_SCALER_FULL_LINE)
+        || RENDER_DrawLine == RENDER_DrawLine_countdown || RENDER_DrawLine == RENDER_DrawLine_countdown_wait
+#endif
+        ) {
+        RENDER_DrawLine(render.scale.cacheRead);
+        return true;
+    }
+
+    return false;
+}
+
 static void RENDER_ClearCacheHandler(const void * src) {
     if (render.disablerender)
         return;
@@ -396,8 +426,23 @@ static void RENDER_ClearCacheHandler(const void * src) {
 
 extern void GFX_SetTitle(int32_t cycles, int frameskip, Bits timing, bool paused);
 
+static bool RENDER_DrawLineKeepsCache(void) {
+    if (RENDER_DrawLine == RENDER_StartLineHandler || RENDER_DrawLine == RENDER_ScalerLineHandler ||
+        RENDER_DrawLine == RENDER_ClearCacheHandler || RENDER_DrawLine == render.scale.linePalHandler)
+        return true;
+#if defined(C_SCALER_FULL_LINE)
+    if (RENDER_DrawLine == RENDER_DrawLine_countdown || RENDER_DrawLine == RENDER_DrawLine_countdown_wait)
+        return true;
+#endif
+    return false;
+}
+
 bool RENDER_StartUpdate(void) {
 
+    if (GCC_UNLIKELY(benchmark_mode)) { /* count the frame, but do not draw it */
+        benchmark_frames++;
+        return false;
+    }
     if (GCC_UNLIKELY(render.updating))
         return false;
     if (GCC_UNLIKELY(!render.active))
@@ -483,6 +528,9 @@ void RENDER_EndUpdate( bool abort ) {
     if (!abort && render.active && RENDER_DrawLine == RENDER_ClearCacheHandler)
         render.scale.clearCache = false;
 
+    /* the cache can only be trusted to match the last frame if every line went through a handler that keeps it */
+    render.frameCached = !abort && render.active && !render.disablerender && RENDER_DrawLineKeepsCache();
+
     RENDER_DrawLine = RENDER_EmptyLineHandler;
     if (render.disablerender) {
         GFX_EndUpdate(nullptr);
@@ -4083,6 +4083,7 @@ static void GUI_StartUp() {
     sdl.gamelink.enable = section->Get_bool("gamelink master");
     sdl.gamelink.snoop = section->Get_bool("gamelink snoop");
     sdl.gamelink.loadaddr = section->Get_int("gamelink load address");
+    sdl.gamelink.protocol = section->Get_int("gamelink protocol");
 #endif
 
 
@@ -7002,6 +7003,12 @@ void SDL_SetupConfigSection() {
     Pbool->Set_help("Connect to an existing Game Link session and output link data instead of sending own data. Compares memory contents to find a suitable memory offset of peeks.");
     Pint = sdl_sec->Add_int("gamelink load address", Property::Changeable::Always, 0);
     Pbool->Set_help("Configure the original load address of the software (when running in plain DOSBox) so that gamelink accesses are adjusted for different load addresses.");
+    const char* gamelinkprotocols[] = { "4", "5", nullptr };
+    Pint = sdl_sec->Add_int("gamelink protocol", Property::Changeable::OnlyAtStart, 4);
+    Pint->Set_values(gamelinkprotocols);
+    Pint->Set_help("Game Link protocol version for output=gamelink. Version 4 is understood by all clients.\n"
+        "Version 5 passes frames through a separate triple-buffered ring with per-line change information,\n"
+        "which allows frames up to 3840x2400 and does not make the client wait for the emulator.");
 #endif
 
     Pint = sdl_sec->Add_int("overscan",Property::Changeable::Always, 0);
@@ -7426,6 +7433,10 @@ bool DOSBOX_parse_argv() {
             fprintf(stderr,"  -set <section property=value>           Set the config option (overriding the config file).\n");
             fprintf(stderr,"                                          Make sure to surround the string in quotes to cover spaces.\n");
             fprintf(stderr,"  -time-limit <n>                         Kill the emulator after 'n' seconds\n");
+            fprintf(stderr,"  -benchmark                              Run silently as fast as possible without drawing, then print\n");
+            fprintf(stderr,"                                          a report of the work done. -time-limit counts emulated time.\n");
+            fprintf(stderr,"  -benchmark-instructions <n>             Stop the benchmark after 'n' emulated instructions\n");
+            fprintf(stderr,"  -benchmark-report <file>                Write the benchmark report to a file instead of stdout\n");
             fprintf(stderr,"  -fastlaunch                             Fast launch mode (skip the BIOS logo and welcome banner)\n");
 #if C_DEBUG
             fprintf(stderr,"  -helpdebug                              Show debug-related options\n");
@@ -7505,6 +7516,22 @@ bool DOSBOX_parse_argv() {
             control->opt_nomenu = true;
             control->opt_fastlaunch = true;
         }
+        else if (optname == "benchmark") {
+            putenv(const_cast<char*>("SDL_AUDIODRIVER=dummy"));
+            putenv(const_cast<char*>("SDL_VIDEODRIVER=dummy"));
+            control->opt_exit = true;
+            control->opt_silent = true;
+            control->opt_nomenu = true;
+            control->opt_fastlaunch = true;
+            control->opt_benchmark = true;
+        }
+        else if (optname == "benchmark-instructions") {
+            if (!control->cmdline->NextOptArgv(tmp)) return false;
+            control->opt_benchmark_instructions = strtoull(tmp.c_str(), NULL, 10);
+        }
+        else if (optname == "benchmark-report") {
+            if (!control->cmdline->NextOptArgv(control->opt_benchmark_report)) return false;
+        }
         else if (optname == "test" || optname == "tests" || optname == "gtest_list_tests") {
             putenv(const_cast<char*>("SDL_VIDEODRIVER=dummy"));
             control->opt_test = true;
@@ -8353,6 +8380,10 @@ int main(int argc, char* argv[]) SDL_MAIN_NOEXCEPT {
 
     if (control->opt_time_limit > 0)
         time_limit_ms = (Bitu)(control->opt_time_limit * 1000);
+    if (control->opt_benchmark) {
+        benchmark_mode = true;
+        benchmark_instruction_limit = control->opt_benchmark_instructions;
+    }
 
     if (control->opt_console)
         DOSBox_ShowConsole();
@@ -10445,6 +10476,19 @@ fresh_boot:
         Reflect_Menu();
 #endif
 
+        if (benchmark_mode) {
+            const std::string report = DOSBOX_BenchmarkReport();
+            FILE *fp = control->opt_benchmark_report.empty() ? stdout : fopen(control->opt_benchmark_report.c_str(), "w");
+            if (fp != NULL) {
+                fputs(report.c_str(), fp);
+                if (fp != stdout) fclose(fp);
+                else fflush(fp);
+            }
+            else {
+                LOG_MSG("Cannot write the benchmark report to %s", control->opt_benchmark_report.c_str());
+            }
+        }
+
         /* and then shutdown */
         GFX_ShutDown();
 
@@ -32,8 +32,14 @@
 #include "bitop.h"
 #include "math.h"
 #include "regs.h"
+#include <algorithm>
 using namespace std;
 
+#if defined(__SSE2__) || defined(_M_AMD64) || defined(_M_X64)
+# include <emmintrin.h>
+# define GUS_SSE2 1
+#endif
+
 #if defined(_MSC_VER)
 # pragma warning(disable:4244) /* const fmath::local::uint64_t to double possible loss of data */
 #endif
@@ -69,6 +75,9 @@ enum GUSType {
 #define WCTRL_DECREASING        0x40
 #define WCTRL_IRQPENDING        0x80
 
+// voices are rendered in blocks of up to this many samples between loop, ramp and IRQ events
+#define GUS_RENDER_BLOCK 64
+
 // fixed panning table (avx)
 static uint16_t const pantablePDF[16] = { 0, 13, 26, 41, 57, 72, 94, 116, 141, 169, 203, 244, 297, 372, 500, 4095 };
 static bool gus_fixed_table = false;
@@ -409,13 +418,14 @@ class GUSChannel {
 					myGUS.WaveIRQ |= irqmask;
 			}
 		}
+		static INLINE int32_t PannedVolume(const uint32_t vol,const uint32_t pan) {
+			int32_t temp=(int32_t)vol - (int32_t)pan;
+			temp&=~(temp >> 31); /* <- NTS: This is a rather elaborate way to clamp negative values to zero using negate and sign extend */
+			return vol16bit[temp >> RAMP_FRACT];
+		}
 		INLINE void UpdateVolumes(void) {
-			int32_t templeft=(int32_t)RampVol - (int32_t)PanLeft;
-			templeft&=~(templeft >> 31); /* <- NTS: This is a rather elaborate way to clamp negative values to zero using negate and sign extend */
-			int32_t tempright=(int32_t)RampVol - (int32_t)PanRight;
-			tempright&=~(tempright >> 31); /* <- NTS: This is a rather elaborate way to clamp negative values to zero using negate and sign extend */
-			VolLeft=vol16bit[templeft >> RAMP_FRACT];
-			VolRight=vol16bit[tempright >> RAMP_FRACT];
+			VolLeft=PannedVolume(RampVol,PanLeft);
+			VolRight=PannedVolume(RampVol,PanRight);
 		}
 		INLINE void RampUpdate(void) {
 			if (RampCtrl & 0x3) return; /* if the ramping is turned off, then don't change the ramp */
@@ -452,10 +462,127 @@ class GUSChannel {
 			UpdateVolumes();
 		}
 
-		void generateSamples(int32_t* stream, uint32_t len) {
-			int32_t tmpsamp;
-			int i;
+		/* How many of the next WaveUpdate() calls, at most limit, only step the current
+		 * position without reaching the start or end, wrapping around GUS memory or firing
+		 * an IRQ. A stopped voice does not move and its IRQ check gives the same answer
+		 * every time, so one call stands in for any number of them. */
+		INLINE uint32_t WaveSteadySteps(const uint32_t limit) const {
+			if (WaveCtrl & (WCTRL_STOP | WCTRL_STOPPED)) return limit;
+
+			uint32_t room;
+			if (WaveCtrl & WCTRL_DECREASING) {
+				if (WaveAddr < WaveStart) return 0;
+				room = WaveAddr - WaveStart;
+			}
+			else {
+				const uint32_t top = std::min(WaveEnd, (uint32_t)((1u << (WAVE_FRACT + 20/*1MB*/)) - 1u));
+				if (WaveAddr > top) return 0;
+				room = top - WaveAddr;
+			}
+			if (WaveAdd == 0 || room / WaveAdd >= limit) return limit;
+			return room / WaveAdd;
+		}
+
+		/* Same for RampUpdate(): steps that move the volume without reaching the end of the ramp */
+		INLINE uint32_t RampSteadySteps(const uint32_t limit) const {
+			if (RampCtrl & 0x3) return limit;
+
+			uint32_t room;
+			if (RampCtrl & 0x40) {
+				if (RampVol <= RampStart) return 0;
+				room = RampVol - RampStart - 1u;
+			}
+			else {
+				if (RampVol >= RampEnd) return 0;
+				room = RampEnd - 1u - RampVol;
+			}
+			if (RampAdd == 0 || room / RampAdd >= limit) return limit;
+			return room / RampAdd;
+		}
+
+		/* Render count samples, then step the voice count times, where the caller has made
+		 * sure that none of the steps reach a loop, ramp or IRQ event. Lc and Rc route the
+		 * left and right volume to the outputs the way the ICS mixer mapping control does. */
+		void renderSteady(int32_t* stream, uint32_t count, const unsigned char Lc, const unsigned char Rc) {
+			int16_t samples[GUS_RENDER_BLOCK];
+			int16_t volumes[GUS_RENDER_BLOCK * 4]; /* per sample: left and right volume into output 0, then into output 1 */
+			const bool wave_running = (WaveCtrl & (WCTRL_STOP | WCTRL_STOPPED)) == 0;
+			const bool ramp_running = (RampCtrl & 0x3) == 0;
+			const uint32_t wave_step = !wave_running ? 0u : (WaveCtrl & WCTRL_DECREASING) ? (0u - WaveAdd) : WaveAdd;
+			const uint32_t ramp_step = !ramp_running ? 0u : (RampCtrl & 0x40) ? (0u - RampAdd) : RampAdd;
+
+			if (!ramp_running) {
+				for (uint32_t j = 0; j < GUS_RENDER_BLOCK; j++)
+					SetVolumes(volumes + j * 4, VolLeft, VolRight, Lc, Rc);
+			}
+
+			while (count > 0) {
+				const uint32_t n = std::min(count, (uint32_t)GUS_RENDER_BLOCK);
+
+				uint32_t addr = WaveAddr;
+				if (WaveCtrl & WCTRL_16BIT) {
+					for (uint32_t j = 0; j < n; j++, addr += wave_step)
+						samples[j] = (int16_t)myGUS.GetSample16(addr);
+				}
+				else {
+					for (uint32_t j = 0; j < n; j++, addr += wave_step)
+						samples[j] = (int16_t)myGUS.GetSample8(addr);
+				}
+				WaveAddr = addr;
+
+				if (ramp_running) {
+					/* the first sample plays at the volume the last step left, every step after that
+					 * moves the ramp and recomputes the volumes */
+					SetVolumes(volumes, VolLeft, VolRight, Lc, Rc);
+					for (uint32_t j = 1; j < n; j++) {
+						RampVol += ramp_step;
+						SetVolumes(volumes + j * 4, PannedVolume(RampVol,PanLeft), PannedVolume(RampVol,PanRight), Lc, Rc);
+					}
+					RampVol += ramp_step;
+					UpdateVolumes();
+				}
+
+				MixSamples(stream, samples, volumes, n);
+				stream += n * 2;
+				count -= n;
+			}
+
+			if (!wave_running) WaveUpdate(); /* IRQ of a stopped voice, see WaveSteadySteps() */
+		}
+
+		static INLINE void SetVolumes(int16_t* v, const int32_t L, const int32_t R, const unsigned char Lc, const unsigned char Rc) {
+			v[0] = (int16_t)((Lc & 1) ? L : 0);
+			v[1] = (int16_t)((Rc & 1) ? R : 0);
+			v[2] = (int16_t)((Lc & 2) ? L : 0);
+			v[3] = (int16_t)((Rc & 2) ? R : 0);
+		}
+
+		/* stream[2j+k] += samples[j] * (volumes[4j+2k] + volumes[4j+2k+1]). Samples and volumes
+		 * (at most 8192) fit 16 bits, so SSE2 pmaddwd does both products and the sum at once. */
+		static void MixSamples(int32_t* stream, const int16_t* samples, const int16_t* volumes, uint32_t n) {
+			uint32_t j = 0;
+#if defined(GUS_SSE2)
+			for (; j + 4 <= n; j += 4) {
+				const __m128i s = _mm_loadl_epi64((const __m128i*)(samples + j));
+				const __m128i ss = _mm_unpacklo_epi16(s, s);
+				const __m128i s01 = _mm_unpacklo_epi32(ss, ss);
+				const __m128i s23 = _mm_unpackhi_epi32(ss, ss);
+				const __m128i v01 = _mm_loadu_si128((const __m128i*)(volumes + j * 4));
+				const __m128i v23 = _mm_loadu_si128((const __m128i*)(volumes + j * 4 + 8));
+				__m128i* out = (__m128i*)(stream + j * 2);
+				_mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), _mm_madd_epi16(s01, v01)));
+				_mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_madd_epi16(s23, v23)));
+			}
+#endif
+			for (; j < n; j++) {
+				const int32_t s = samples[j];
+				const int16_t* v = volumes + j * 4;
+				stream[j * 2] += s * v[0] + s * v[1];
+				stream[j * 2 + 1] += s * v[2] + s * v[3];
+			}
+		}
 
+		void generateSamples(int32_t* stream, uint32_t len) {
 			/* NTS: The GUS is *always* rendering the audio sample at the current position,
 			 *      even if the voice is stopped. This can be confirmed using DOSLIB, loading
 			 *      the Ultrasound test program, loading a WAV file into memory, then using
@@ -463,7 +590,47 @@ class GUSChannel {
 			 *      voice through RAM (abruptly change the current position) while the voice
 			 *      is stopped. You will hear "popping" noises come out the GUS audio output
 			 *      as the current position changes and the piece of the sample rendered
-			 *      abruptly changes as well. */
+			 *      abruptly changes as well.
+			 *
+			 *      Nothing is output and the voice does not move unless the DAC is enabled. */
+			if ((myGUS.GUS_reset_reg & 0x02/*DAC enable*/) != 0x02)
+				return;
+
+			// normal output is left to left, right to right
+			unsigned char Lc = 1, Rc = 2;
+			if (gus_ics_mixer) {
+				// output mapped through ICS mixer including channel remapping
+				Lc = read_GF1_mapping_control(0);
+				Rc = read_GF1_mapping_control(1);
+			}
+
+			uint32_t i = 0;
+			while (i < len) {
+				// render up to the next loop, ramp or IRQ event in blocks, then the event sample by itself
+				const uint32_t n = RampSteadySteps(WaveSteadySteps(len - i));
+				if (n > 0) {
+					renderSteady(stream + (i << 1), n, Lc, Rc);
+					i += n;
+				}
+				else {
+					const int32_t tmpsamp = (WaveCtrl & WCTRL_16BIT) ? GetSample16() : GetSample8();
+					int16_t v[4];
+					SetVolumes(v, VolLeft, VolRight, Lc, Rc);
+					stream[i << 1] += tmpsamp * v[0] + tmpsamp * v[1];
+					stream[(i << 1) + 1] += tmpsamp * v[2] + tmpsamp * v[3];
+
+					WaveUpdate();
+					RampUpdate();
+					i++;
+				}
+			}
+		}
+
+		/* The renderer before the block one, one sample at a time */
+		void generateSamplesPerSample(int32_t* stream, uint32_t len) {
+			int32_t tmpsamp;
+			int i;
+
 			if (gus_ics_mixer) {
 				const unsigned char Lc = read_GF1_mapping_control(0);
 				const unsigned char Rc = read_GF1_mapping_control(1);
@@ -2099,15 +2266,56 @@ static void GUS_DMA_Callback(DmaChannel * chan,DMAEvent event) {
 	}
 }
 
-static void GUS_CallBack(Bitu len) {
-	int32_t buffer[MIXER_BUFSIZE][2];
-	memset(buffer, 0, len * sizeof(buffer[0]));
-
+/* Add the active voices into stream, len stereo samples. per_sample uses the renderer
+ * that steps every voice one sample at a time, which the block renderer must match. */
+void GUS_RenderVoices(int32_t* stream, Bitu len, bool per_sample) {
 	if ((myGUS.GUS_reset_reg & 0x01/*!master reset*/) == 0x01) {
 		for (Bitu i = 0; i < myGUS.ActiveChannels; i++) {
-			guschan[i]->generateSamples(buffer[0], len);
+			if (per_sample)
+				guschan[i]->generateSamplesPerSample(stream, (uint32_t)len);
+			else
+				guschan[i]->generateSamples(stream, (uint32_t)len);
 		}
 	}
+}
+
+/* Scale and clip the samples at the start of buffer that leave AutoAmp as it is, which is all
+ * of them at full volume unless one clips while auto amplification is enabled. Returns how
+ * many it did. */
+static Bitu GUS_ScaleSteady(int32_t* buffer, Bitu len) {
+	if (AutoAmp < myGUS.masterVolumeMul) return 0; /* recovering, AutoAmp changes every sample */
+
+	const int shift = (VOL_SHIFT * AutoAmp) >> 9;
+	Bitu i = 0;
+#if defined(GUS_SSE2)
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	for (; i + 2 <= len; i += 2) {
+		__m128i* const p = (__m128i*)(buffer + i * 2);
+		const __m128i v = _mm_sra_epi32(_mm_loadu_si128(p), count);
+		/* saturate to 16 bits and sign extend back */
+		const __m128i packed = _mm_packs_epi32(v, v);
+		const __m128i c = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+		if (enable_autoamp && _mm_movemask_epi8(_mm_cmpeq_epi32(c, v)) != 0xFFFF) break;
+		_mm_storeu_si128(p, c);
+	}
+#endif
+	for (; i < len; i++) {
+		int32_t* const p = buffer + i * 2;
+		const int32_t L = p[0] >> shift, R = p[1] >> shift;
+		const int32_t cL = std::max(-32768, std::min(32767, L));
+		const int32_t cR = std::max(-32768, std::min(32767, R));
+		if (enable_autoamp && (cL != L || cR != R)) break;
+		p[0] = cL;
+		p[1] = cR;
+	}
+	return i;
+}
+
+static void GUS_CallBack(Bitu len) {
+	int32_t buffer[MIXER_BUFSIZE][2];
+	memset(buffer, 0, len * sizeof(buffer[0]));
+
+	GUS_RenderVoices(buffer[0], len, false);
 
 	// FIXME: I wonder if the GF1 chip DAC had more than 16 bits precision
 	//        to render louder than 100% volume without clipping, and if so,
@@ -2135,6 +2343,9 @@ static void GUS_CallBack(Bitu len) {
 	//        --J.C.
 
 	for (Bitu i = 0; i < len; i++) {
+		i += GUS_ScaleSteady(buffer[i], len - i);
+		if (i >= len) break;
+
 		buffer[i][0] >>= (VOL_SHIFT * AutoAmp) >> 9;
 		buffer[i][1] >>= (VOL_SHIFT * AutoAmp) >> 9;
 		bool dampenedAutoAmp = false;
@@ -35,6 +35,8 @@
 #include "bios_disk.h"
 #include "../src/dos/cdrom.h"
 #include "bios.h"
+#include "paging.h"
+#include "pci_bus.h"
 
 #if defined(_MSC_VER)
 # pragma warning(disable:4244) /* const fmath::local::uint64_t to double possible loss of data */
@@ -136,6 +138,15 @@ enum IDEDeviceState {
     IDE_DEV_ATAPI_BUSY
 };
 
+enum {
+    IDE_BM_CMD_START=0x01,          /* bus master command: start/stop */
+    IDE_BM_CMD_WRITE=0x08,          /* bus master command: 1=bus master writes to memory (device read) */
+    IDE_BM_STATUS_ACTIVE=0x01,      /* bus master status: transfer in progress */
+    IDE_BM_STATUS_ERROR=0x02,       /* bus master status: error (write 1 to clear) */
+    IDE_BM_STATUS_IRQ=0x04,         /* bus master status: IDE interrupt seen (write 1 to clear) */
+    IDE_BM_STATUS_DMA_CAPABLE=0x60  /* bus master status: drive 0/1 DMA capable (software set) */
+};
+
 enum {
     IDE_STATUS_BUSY=0x80,
     IDE_STATUS_DRIVE_READY=0x40,
@@ -174,6 +185,8 @@ public:
     bool motor_on;
     bool asleep;
     bool slave;
+    bool dma_transfer; /* if set, the data phase of the current command is moved by the bus master instead of PIO */
+    uint8_t transfer_mode; /* last transfer mode set by SET FEATURES 03h (08h+n=PIO n, 20h+n=MWDMA n, 40h+n=UDMA n) */
     IDEDeviceState state;
     /* feature: 0x1F1 (Word 00h in ATA specs)
          count: 0x1F2 (Word 01h in ATA specs)
@@ -218,6 +231,9 @@ public:
     virtual void data_write(Bitu v,Bitu iolen);/* write to 1F0h data port to IDE device */
     virtual bool command_interruption_ok(uint8_t cmd);
     virtual void abort_silent();
+    virtual void dma_service(); /* bus master is ready to move the pending DRQ block */
+protected:
+    bool dma_service_block(unsigned char *buf,Bitu &buf_i,Bitu buf_total);
 };
 
 class IDEATADevice:public IDEDevice {
@@ -239,6 +255,8 @@ public:
     virtual void prepare_write(Bitu offset,Bitu size);
     virtual void io_completion();
     virtual bool increment_current_address(Bitu count=1);
+    virtual bool current_sector(uint32_t &sectorn);
+    void dma_service() override;
 public:
     uint64_t multiple_sector_max,multiple_sector_count;
     uint64_t heads,sects,cyls,progress_count;
@@ -292,6 +310,7 @@ public:
     virtual void play_audio10();
     virtual void mode_sense();
     virtual void read_toc();
+    void dma_service() override;
 public:
     bool atapi_to_host;         /* if set, PACKET data transfer is to be read by host */
     double spinup_time;
@@ -340,11 +359,20 @@ public:
     double spinup_time;
     double spindown_timeout;
     double cd_insertion_time;
+    /* PCI bus master IDE (SFF-8038i) state for this interface */
+    bool busmaster_enable;      /* interface is serviced by the PCI bus master IDE function */
+    uint8_t bm_command,bm_status;
+    uint32_t bm_prd;            /* PRD table address as programmed by the guest */
+    uint32_t bm_prd_cur;        /* next PRD entry to fetch */
+    uint32_t bm_region_addr,bm_region_left;
+    bool bm_region_eot;
 public:
     IDEController(Section* configuration,unsigned char index);
     void register_isapnp();
     void install_io_port();
     void check_device_irq();
+    bool busmaster_active();
+    Bitu busmaster_transfer(unsigned char *buf,Bitu len,bool to_memory);
     ~IDEController();
 private:// Sorry, IDE devices and external code don't get to force IDE IRQs anymore
     void raise_irq();
@@ -1671,6 +1699,7 @@ void IDEATAPICDROMDevice::atapi_io_completion() {
     status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
     state = IDE_DEV_READY;
     allow_writing = true;
+    dma_transfer = false;
 
     /* Apparently: real IDE ATAPI controllers fire another IRQ after the transfer.
        And there are MS-DOS CD-ROM drivers that assume that. */
@@ -1698,6 +1727,12 @@ void IDEATAPICDROMDevice::io_completion() {
     }
 }
 
+/* bus master DMA: move the pending DRQ block of the PACKET command in one go */
+void IDEATAPICDROMDevice::dma_service() {
+    if (dma_service_block(sector,sector_i,sector_total))
+        io_completion();
+}
+
 bool IDEATADevice::increment_current_address(Bitu count) {
     if (count == 0) return false;
 
@@ -1748,6 +1783,51 @@ bool IDEATADevice::increment_current_address(Bitu count) {
     return true;
 }
 
+/* compute the absolute sector number from the LBA or C/H/S in the task file.
+ * returns false (and logs why) if the C/H/S address is invalid. */
+bool IDEATADevice::current_sector(uint32_t &sectorn) {
+    if (drivehead_is_lba(drivehead)) {
+        /* LBA */
+        sectorn = (((unsigned int)drivehead & 0xFu) << 24u) | (unsigned int)lba[0] |
+            ((unsigned int)lba[1] << 8u) |
+            ((unsigned int)lba[2] << 16u);
+    }
+    else {
+        /* C/H/S */
+        if (lba[0] == 0) {
+            LOG_MSG("WARNING C/H/S access mode and sector==0\n");
+            return false;
+        }
+        else if ((unsigned int)(drivehead & 0xF) >= (unsigned int)heads ||
+            (unsigned int)lba[0] > (unsigned int)sects ||
+            (unsigned int)(lba[1] | ((unsigned int)lba[2] << 8u)) >= (unsigned int)cyls) {
+            LOG_MSG("C/H/S %u/%u/%u out of bounds %u/%u/%u\n",
+                (unsigned int)(lba[1] | ((unsigned int)lba[2] << 8u)),
+                (unsigned int)(drivehead&0xFu),
+                (unsigned int)lba[0],
+                (unsigned int)cyls,
+                (unsigned int)heads,
+                (unsigned int)sects);
+            return false;
+        }
+
+        sectorn = (((unsigned int)drivehead & 0xFu) * sects) +
+            (((unsigned int)lba[1] | ((unsigned int)lba[2] << 8u)) * sects * heads) +
+            ((unsigned int)lba[0] - 1u);
+    }
+
+    return true;
+}
+
+/* bus master DMA: move the pending DRQ block between the sector buffer and guest memory
+ * in one go, then continue the command exactly as if the host had done it by PIO. */
+void IDEATADevice::dma_service() {
+    Bitu pos = (Bitu)sector_i;
+    const bool done = dma_service_block(sector,pos,(Bitu)sector_total);
+    sector_i = pos;
+    if (done) io_completion();
+}
+
 void IDEATADevice::io_completion() {
     const unsigned int pk = IDEEventPack(controller->interface_index,slave?1u:0u).get();
 
@@ -1826,6 +1906,44 @@ void IDEATADevice::io_completion() {
             PIC_RemoveSpecificEvents(IDE_DelayedCommand,pk);
             PIC_AddEvent(IDE_DelayedCommand,((progress_count == 0 && !faked_command) ? 0.1 : 0.00001)/*ms*/,pk);
             break;
+        case 0xC8:/* READ DMA */
+            /* the bus master has taken the whole block, advance by however many sectors it held */
+            for (unsigned int cc=0;cc < (sector_total/512u);cc++) {
+                progress_count++;
+                if ((count&0xFF) == 1) {
+                    /* end of the transfer. unlike PIO, DMA signals the IRQ only once, at the end */
+                    count = 0;
+                    status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
+                    state = IDE_DEV_READY;
+                    allow_writing = true;
+                    dma_transfer = false;
+                    raise_irq();
+                    return;
+                }
+                else if ((count&0xFF) == 0) count = 255;
+                else count--;
+
+                if (!increment_current_address()) {
+                    LOG_MSG("READ advance error\n");
+                    abort_error();
+                    raise_irq();
+                    return;
+                }
+            }
+
+            /* cause another delay, another block read */
+            state = IDE_DEV_BUSY;
+            status = IDE_STATUS_BUSY;
+            PIC_RemoveSpecificEvents(IDE_DelayedCommand,pk);
+            PIC_AddEvent(IDE_DelayedCommand,0.00001/*ms*/,pk);
+            break;
+        case 0xCA:/* WRITE DMA */
+            /* the bus master has filled the block, lower DRQ and write it to disk */
+            state = IDE_DEV_BUSY;
+            status = IDE_STATUS_BUSY;
+            PIC_RemoveSpecificEvents(IDE_DelayedCommand,pk);
+            PIC_AddEvent(IDE_DelayedCommand,((progress_count == 0 && !faked_command) ? 0.1 : 0.00001)/*ms*/,pk);
+            break;
         case 0xEC: /* IDENTIFY */
             feature = 0;
             status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
@@ -2501,7 +2619,7 @@ void IDEATAPICDROMDevice::generate_identify_device() {
     host_writew(sector+(49*2),
         0x0800UL|/*IORDY supported*/
         0x0200UL|/*must be one*/
-        0);
+        (controller->busmaster_enable ? 0x0100UL : 0)/*DMA supported*/);
     host_writew(sector+(50*2),
         0x4000UL);
     host_writew(sector+(51*2),
@@ -2510,6 +2628,12 @@ void IDEATAPICDROMDevice::generate_identify_device() {
         0x00F0UL);
     host_writew(sector+(53*2),
         0x0006UL);
+    if (controller->busmaster_enable) {
+        host_writew(sector+(63*2),  /* Multiword DMA modes supported/selected */
+            0x0007UL | (((transfer_mode & 0xF8) == 0x20) ? (0x0100UL << (transfer_mode & 7)) : 0));
+        host_writew(sector+(88*2),  /* Ultra DMA modes supported/selected */
+            0x0007UL | (((transfer_mode & 0xF8) == 0x40) ? (0x0100UL << (transfer_mode & 7)) : 0));
+    }
     host_writew(sector+(64*2),      /* PIO modes supported */
         0x0003UL);
     host_writew(sector+(67*2),      /* PIO cycle time */
@@ -2576,11 +2700,11 @@ void IDEATADevice::generate_identify_device() {
         host_writew(sector+(47*2),0x80|multiple_sector_max); /* <- READ/WRITE MULTIPLE MAX SECTORS */
 
     host_writew(sector+(48*2),0x0000);  /* :0  0=we do not support doubleword (32-bit) PIO */
-    host_writew(sector+(49*2),0x0A00);  /* :13 0=Standby timer values managed by device */
+    host_writew(sector+(49*2),0x0A00|   /* :13 0=Standby timer values managed by device */
                         /* :11 1=IORDY supported */
                         /* :10 0=IORDY not disabled */
                         /* :9  1=LBA supported */
-                        /* :8  0=DMA not supported */
+        (controller->busmaster_enable ? 0x0100 : 0)); /* :8  1=DMA supported (only if attached to the bus master) */
     host_writew(sector+(50*2),0x4000);  /* FIXME: ??? */
     host_writew(sector+(51*2),0x00F0);  /* PIO data transfer cycle timing mode */
     host_writew(sector+(52*2),0x00F0);  /* DMA data transfer cycle timing mode */
@@ -2598,8 +2722,13 @@ void IDEATADevice::generate_identify_device() {
 
     host_writed(sector+(60*2),lba28);  /* total user addressable sectors (LBA) */
     host_writew(sector+(62*2),0x0000);  /* FIXME: ??? */
-    host_writew(sector+(63*2),0x0000);  /* :10 0=Multiword DMA mode 2 not selected */
-                        /* TODO: Basically, we don't do DMA. Fill out this comment */
+    if (controller->busmaster_enable) {
+        /* 10:8 Multiword DMA mode selected, 2:0 Multiword DMA modes 0-2 supported */
+        host_writew(sector+(63*2),0x0007 | (((transfer_mode & 0xF8) == 0x20) ? (0x0100 << (transfer_mode & 7)) : 0));
+    }
+    else {
+        host_writew(sector+(63*2),0x0000);  /* no DMA without the bus master */
+    }
     host_writew(sector+(64*2),0x0003);  /* 7:0 PIO modes supported (FIXME ???) */
     host_writew(sector+(65*2),0x0000);  /* FIXME: ??? */
     host_writew(sector+(66*2),0x0000);  /* FIXME: ??? */
@@ -2613,7 +2742,13 @@ void IDEATADevice::generate_identify_device() {
     host_writew(sector+(85*2),0x4208);  /* commands in 82 enabled */
     host_writew(sector+(86*2),int13_enable_48bitLBA?0xC400:0x4000);  /* commands in 83 enabled bit15: valid, bit14: NOP, bit10: enable 48bit LBA*/
     host_writew(sector+(87*2),0x4000);  /* FIXME: ??? */
-    host_writew(sector+(88*2),0x0000);  /* FIXME: ??? */
+    if (controller->busmaster_enable) {
+        /* 10:8 Ultra DMA mode selected, 2:0 Ultra DMA modes 0-2 supported */
+        host_writew(sector+(88*2),0x0007 | (((transfer_mode & 0xF8) == 0x40) ? (0x0100 << (transfer_mode & 7)) : 0));
+    }
+    else {
+        host_writew(sector+(88*2),0x0000);
+    }
     host_writew(sector+(93*2),0x0000);  /* FIXME: ??? */
     host_writed(sector+(100*2), int13_enable_48bitLBA ? (uint32_t)(LBA & 0xFFFFFFFF):0); // 48bit LBA lower 32 bits
     host_writed(sector+(102*2), int13_enable_48bitLBA ? (uint32_t)(LBA >> 32):0);        // 48bit LBA upper 32 bits 
@@ -3418,38 +3553,10 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
 
                 sectcount = ata->count & 0xFF;
                 if (sectcount == 0) sectcount = 256;
-                if (drivehead_is_lba(ata->drivehead)) {
-                    /* LBA */
-                    sectorn = ((ata->drivehead & 0xFu) << 24u) | (unsigned int)ata->lba[0] |
-                        ((unsigned int)ata->lba[1] << 8u) |
-                        ((unsigned int)ata->lba[2] << 16u);
-                }
-                else {
-                    /* C/H/S */
-                    if (ata->lba[0] == 0) {
-                        LOG_MSG("ATA sector 0 does not exist\n");
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-                    else if ((unsigned int)(ata->drivehead & 0xFu) >= (unsigned int)ata->heads ||
-                        (unsigned int)ata->lba[0] > (unsigned int)ata->sects ||
-                        (unsigned int)(ata->lba[1] | (ata->lba[2] << 8u)) >= (unsigned int)ata->cyls) {
-                        LOG_MSG("C/H/S %u/%u/%u out of bounds %u/%u/%u\n",
-                            (unsigned int)(ata->lba[1] | (ata->lba[2] << 8u)),
-                            (unsigned int)(ata->drivehead&0xFu),
-                            (unsigned int)(ata->lba[0]),
-                            (unsigned int)ata->cyls,
-                            (unsigned int)ata->heads,
-                            (unsigned int)ata->sects);
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-
-                    sectorn = ((ata->drivehead & 0xF) * ata->sects) +
-                        (((unsigned int)ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) * ata->sects * ata->heads) +
-                        ((unsigned int)ata->lba[0] - 1u);
+                if (!ata->current_sector(sectorn)) {
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
                 }
 
                 if (disk->Write_AbsoluteSector(sectorn, ata->sector) != 0) {
@@ -3500,38 +3607,10 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
 
                 sectcount = ata->count & 0xFF;
                 if (sectcount == 0) sectcount = 256;
-                if (drivehead_is_lba(ata->drivehead)) {
-                    /* LBA */
-                    sectorn = (((unsigned int)ata->drivehead & 0xFu) << 24u) | (unsigned int)ata->lba[0] |
-                        ((unsigned int)ata->lba[1] << 8u) |
-                        ((unsigned int)ata->lba[2] << 16u);
-                }
-                else {
-                    /* C/H/S */
-                    if (ata->lba[0] == 0) {
-                        LOG_MSG("WARNING C/H/S access mode and sector==0\n");
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-                    else if ((unsigned int)(ata->drivehead & 0xF) >= (unsigned int)ata->heads ||
-                        (unsigned int)ata->lba[0] > (unsigned int)ata->sects ||
-                        (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) >= (unsigned int)ata->cyls) {
-                        LOG_MSG("C/H/S %u/%u/%u out of bounds %u/%u/%u\n",
-                            (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)),
-                            (unsigned int)(ata->drivehead&0xF),
-                            (unsigned int)ata->lba[0],
-                            (unsigned int)ata->cyls,
-                            (unsigned int)ata->heads,
-                            (unsigned int)ata->sects);
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-
-                    sectorn = ((ata->drivehead & 0xFu) * ata->sects) +
-                        (((unsigned int)ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) * ata->sects * ata->heads) +
-                        ((unsigned int)ata->lba[0] - 1u);
+                if (!ata->current_sector(sectorn)) {
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
                 }
 
                 if (disk->Read_AbsoluteSector(sectorn, ata->sector) != 0) {
@@ -3564,38 +3643,10 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
 
                 sectcount = ata->count & 0xFF;
                 if (sectcount == 0) sectcount = 256;
-                if (drivehead_is_lba(ata->drivehead)) {
-                    /* LBA */
-                    sectorn = (((unsigned int)ata->drivehead & 0xFu) << 24u) | (unsigned int)ata->lba[0] |
-                        ((unsigned int)ata->lba[1] << 8u) |
-                        ((unsigned int)ata->lba[2] << 16u);
-                }
-                else {
-                    /* C/H/S */
-                    if (ata->lba[0] == 0) {
-                        LOG_MSG("WARNING C/H/S access mode and sector==0\n");
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-                    else if ((unsigned int)(ata->drivehead & 0xF) >= (unsigned int)ata->heads ||
-                        (unsigned int)ata->lba[0] > (unsigned int)ata->sects ||
-                        (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) >= (unsigned int)ata->cyls) {
-                        LOG_MSG("C/H/S %u/%u/%u out of bounds %u/%u/%u\n",
-                            (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)),
-                            (unsigned int)(ata->drivehead&0xFu),
-                            (unsigned int)ata->lba[0],
-                            (unsigned int)ata->cyls,
-                            (unsigned int)ata->heads,
-                            (unsigned int)ata->sects);
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-
-                    sectorn = (((unsigned int)ata->drivehead & 0xFu) * ata->sects) +
-                        (((unsigned int)ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) * ata->sects * ata->heads) +
-                        ((unsigned int)ata->lba[0] - 1u);
+                if (!ata->current_sector(sectorn)) {
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
                 }
 
                 if (disk->Read_AbsoluteSector(sectorn, ata->sector) != 0) {
@@ -3641,38 +3692,10 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
 
                 sectcount = ata->count & 0xFF;
                 if (sectcount == 0) sectcount = 256;
-                if (drivehead_is_lba(ata->drivehead)) {
-                    /* LBA */
-                    sectorn = (((unsigned int)ata->drivehead & 0xFu) << 24u) | (unsigned int)ata->lba[0] |
-                        ((unsigned int)ata->lba[1] << 8u) |
-                        ((unsigned int)ata->lba[2] << 16u);
-                }
-                else {
-                    /* C/H/S */
-                    if (ata->lba[0] == 0) {
-                        LOG_MSG("WARNING C/H/S access mode and sector==0\n");
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-                    else if ((unsigned int)(ata->drivehead & 0xF) >= (unsigned int)ata->heads ||
-                        (unsigned int)ata->lba[0] > (unsigned int)ata->sects ||
-                        (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) >= (unsigned int)ata->cyls) {
-                        LOG_MSG("C/H/S %u/%u/%u out of bounds %u/%u/%u\n",
-                            (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)),
-                            (unsigned int)(ata->drivehead&0xF),
-                            (unsigned int)ata->lba[0],
-                            (unsigned int)ata->cyls,
-                            (unsigned int)ata->heads,
-                            (unsigned int)ata->sects);
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
-
-                    sectorn = ((ata->drivehead & 0xF) * ata->sects) +
-                        (((unsigned int)ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) * ata->sects * ata->heads) +
-                        ((unsigned int)ata->lba[0] - 1);
+                if (!ata->current_sector(sectorn)) {
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
                 }
 
                 if ((512*ata->multiple_sector_count) > sizeof(ata->sector))
@@ -3710,42 +3733,104 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
 
                 sectcount = ata->count & 0xFF;
                 if (sectcount == 0) sectcount = 256;
-                if (drivehead_is_lba(ata->drivehead)) {
-                    /* LBA */
-                    sectorn = (((unsigned int)ata->drivehead & 0xF) << 24) | (unsigned int)ata->lba[0] |
-                        ((unsigned int)ata->lba[1] << 8) |
-                        ((unsigned int)ata->lba[2] << 16);
+                if (!ata->current_sector(sectorn)) {
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
                 }
-                else {
-                    /* C/H/S */
-                    if (ata->lba[0] == 0) {
-                        LOG_MSG("ATA sector 0 does not exist\n");
+
+                for (unsigned int cc=0;cc < MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);cc++) {
+                    /* it would be great if the disk object had a "write multiple sectors" member function */
+                    if (disk->Write_AbsoluteSector(sectorn+cc, ata->sector+(cc*512)) != 0) {
+                        LOG_MSG("Failed to write sector\n");
                         ata->abort_error();
                         dev->raise_irq();
                         return;
                     }
-                    else if ((unsigned int)(ata->drivehead & 0xF) >= (unsigned int)ata->heads ||
-                        (unsigned int)ata->lba[0] > (unsigned int)ata->sects ||
-                        (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8)) >= (unsigned int)ata->cyls) {
-                        LOG_MSG("C/H/S %u/%u/%u out of bounds %u/%u/%u\n",
-                            (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8)),
-                            (unsigned int)(ata->drivehead&0xF),
-                            (unsigned int)ata->lba[0],
-                            (unsigned int)ata->cyls,
-                            (unsigned int)ata->heads,
-                            (unsigned int)ata->sects);
+                }
+
+                for (unsigned int cc=0;cc < MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);cc++) {
+                    if ((ata->count&0xFF) == 1) {
+                        /* end of the transfer */
+                        ata->count = 0;
+                        ata->status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
+                        dev->raise_irq();
+                        ata->state = IDE_DEV_READY;
+                        ata->allow_writing = true;
+                        return;
+                    }
+                    else if ((ata->count&0xFF) == 0) ata->count = 255;
+                    else ata->count--;
+                    ata->progress_count++;
+
+                    if (!ata->increment_current_address()) {
+                        LOG_MSG("READ advance error\n");
+                        ata->abort_error();
+                        return;
+                    }
+                }
+
+                /* begin another sector */
+                sectcount = ata->count & 0xFF;
+                if (sectcount == 0) sectcount = 256;
+                dev->state = IDE_DEV_DATA_WRITE;
+                dev->status = IDE_STATUS_DRQ|IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
+                ata->prepare_write(0,512*MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount));
+                dev->raise_irq();
+                break;
+            case 0xC8:/* READ DMA */
+                disk = ata->getBIOSdisk();
+                if (disk == NULL) {
+                    LOG_MSG("ATA READ fail, bios disk N/A\n");
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
+                }
+
+                sectcount = ata->count & 0xFF;
+                if (sectcount == 0) sectcount = 256;
+                if (!ata->current_sector(sectorn)) {
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
+                }
+
+                /* read as much as the sector buffer holds, the bus master moves it all at once */
+                sectcount = (unsigned int)MIN((Bitu)sectcount,(Bitu)(sizeof(ata->sector)/512u));
+                for (unsigned int cc=0;cc < sectcount;cc++) {
+                    if (disk->Read_AbsoluteSector(sectorn+cc, ata->sector+(cc*512)) != 0) {
+                        LOG_MSG("ATA read failed\n");
                         ata->abort_error();
                         dev->raise_irq();
                         return;
                     }
+                }
 
-                    sectorn = ((unsigned int)(ata->drivehead & 0xF) * ata->sects) +
-                        (((unsigned int)ata->lba[1] | ((unsigned int)ata->lba[2] << 8)) * ata->sects * ata->heads) +
-                        ((unsigned int)ata->lba[0] - 1);
+                /* NTS: The sector advance + count decrement is done in the I/O completion function */
+                dev->state = IDE_DEV_DATA_READ;
+                dev->status = IDE_STATUS_DRQ|IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
+                ata->prepare_read(0,512*sectcount);
+                ata->dma_service();
+                break;
+
+            case 0xCA:/* WRITE DMA */
+                disk = ata->getBIOSdisk();
+                if (disk == NULL) {
+                    LOG_MSG("ATA READ fail, bios disk N/A\n");
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
                 }
 
-                for (unsigned int cc=0;cc < MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);cc++) {
-                    /* it would be great if the disk object had a "write multiple sectors" member function */
+                if (!ata->current_sector(sectorn)) {
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
+                }
+
+                /* write the block the bus master just filled */
+                sectcount = (unsigned int)(ata->sector_total / 512u);
+                for (unsigned int cc=0;cc < sectcount;cc++) {
                     if (disk->Write_AbsoluteSector(sectorn+cc, ata->sector+(cc*512)) != 0) {
                         LOG_MSG("Failed to write sector\n");
                         ata->abort_error();
@@ -3754,14 +3839,15 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
                     }
                 }
 
-                for (unsigned int cc=0;cc < MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);cc++) {
+                for (unsigned int cc=0;cc < sectcount;cc++) {
                     if ((ata->count&0xFF) == 1) {
-                        /* end of the transfer */
+                        /* end of the transfer. unlike PIO, DMA signals the IRQ only once, at the end */
                         ata->count = 0;
                         ata->status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
-                        dev->raise_irq();
                         ata->state = IDE_DEV_READY;
                         ata->allow_writing = true;
+                        ata->dma_transfer = false;
+                        dev->raise_irq();
                         return;
                     }
                     else if ((ata->count&0xFF) == 0) ata->count = 255;
@@ -3769,20 +3855,22 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
                     ata->progress_count++;
 
                     if (!ata->increment_current_address()) {
-                        LOG_MSG("READ advance error\n");
+                        LOG_MSG("WRITE advance error\n");
                         ata->abort_error();
+                        dev->raise_irq();
                         return;
                     }
                 }
 
-                /* begin another sector */
+                /* begin another block */
                 sectcount = ata->count & 0xFF;
                 if (sectcount == 0) sectcount = 256;
                 dev->state = IDE_DEV_DATA_WRITE;
                 dev->status = IDE_STATUS_DRQ|IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
-                ata->prepare_write(0,512*MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount));
-                dev->raise_irq();
+                ata->prepare_write(0,512*MIN((Bitu)sectcount,(Bitu)(sizeof(ata->sector)/512u)));
+                ata->dma_service();
                 break;
+
             case 0xEC:/*IDENTIFY DEVICE (CONTINUED) */
                 dev->state = IDE_DEV_DATA_READ;
                 dev->status = IDE_STATUS_DRQ|IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
@@ -3864,6 +3952,7 @@ void IDEController::check_device_irq() {
 
 void IDEController::raise_irq() {
     irq_pending = true;
+    bm_status |= IDE_BM_STATUS_IRQ;
     if (IS_PC98_ARCH) {
         PC98_IDE_UpdateIRQ();
     }
@@ -3901,6 +3990,13 @@ IDEController *match_ide_controller(Bitu port) {
 }
 
 void IDEDevice::raise_irq() {
+    /* in DMA mode the data phase is handed to the bus master instead of the host.
+     * the host only sees the IRQ at the end of the command. */
+    if (dma_transfer && (status & IDE_STATUS_DRQ) && (state == IDE_DEV_DATA_READ || state == IDE_DEV_DATA_WRITE)) {
+        dma_service();
+        return;
+    }
+
     if (!irq_signal) {
         irq_signal = true;
         controller->check_device_irq();
@@ -3924,6 +4020,20 @@ void IDEDevice::data_write(Bitu v,Bitu iolen) {
     (void)v;//UNUSED
 }
 
+void IDEDevice::dma_service() {
+}
+
+/* bus master DMA: move what is left of the DRQ block buf[buf_i..buf_total) between the device
+ * and guest memory, as far as the PRD table allows. returns true once the block is complete. */
+bool IDEDevice::dma_service_block(unsigned char *buf,Bitu &buf_i,Bitu buf_total) {
+    if (!dma_transfer || !(status & IDE_STATUS_DRQ)) return false;
+    if (state != IDE_DEV_DATA_READ && state != IDE_DEV_DATA_WRITE) return false;
+    if (!controller->busmaster_active()) return false; /* wait for the guest to set the start bit */
+
+    buf_i += controller->busmaster_transfer(buf+buf_i,buf_total-buf_i,/*to memory*/state == IDE_DEV_DATA_READ);
+    return buf_i >= buf_total;
+}
+
 IDEDevice::IDEDevice(IDEController *c,bool _slave) {
     type = IDE_TYPE_NONE;
     slave = _slave;
@@ -3932,6 +4042,8 @@ IDEDevice::IDEDevice(IDEController *c,bool _slave) {
     motor_on = true;
     irq_signal = false;
     allow_writing = true;
+    dma_transfer = false;
+    transfer_mode = 0;
     state = IDE_DEV_READY;
     feature = count = lba[0] = lba[1] = lba[2] = command = drivehead = 0;
     status = IDE_STATUS_DRIVE_READY | IDE_STATUS_DRIVE_SEEK_COMPLETE;
@@ -3981,6 +4093,7 @@ void IDEDevice::abort_silent() {
     /* a command was written while another is in progress */
     state = IDE_DEV_READY;
     allow_writing = true;
+    dma_transfer = false;
     command = 0x00;
     status = IDE_STATUS_ERROR | IDE_STATUS_DRIVE_READY | IDE_STATUS_DRIVE_SEEK_COMPLETE;
 }
@@ -3992,6 +4105,7 @@ void IDEDevice::abort_error() {
     /* a command was written while another is in progress */
     state = IDE_DEV_READY;
     allow_writing = true;
+    dma_transfer = false;
     command = 0x00;
     status = IDE_STATUS_ERROR | IDE_STATUS_DRIVE_READY | IDE_STATUS_DRIVE_SEEK_COMPLETE;
 }
@@ -4000,6 +4114,7 @@ void IDEDevice::abort_normal() {
     /* a command was written while another is in progress */
     state = IDE_DEV_READY;
     allow_writing = true;
+    dma_transfer = false;
     command = 0x00;
     status = IDE_STATUS_DRIVE_READY | IDE_STATUS_DRIVE_SEEK_COMPLETE;
 }
@@ -4083,8 +4198,8 @@ void IDEATAPICDROMDevice::writecommand(uint8_t cmd) {
             allow_writing = true;
             break;
         case 0xA0: /* ATAPI PACKET */
-            if (feature & 1) {
-                /* this code does not support DMA packet commands */
+            if ((feature & 1) && !controller->busmaster_enable) {
+                /* DMA packet commands need the PCI bus master */
                 LOG_MSG("Attempted DMA transfer\n");
                 abort_error();
                 count = 0x03; /* no more data (command/data=1, input/output=1) */
@@ -4094,6 +4209,7 @@ void IDEATAPICDROMDevice::writecommand(uint8_t cmd) {
             else {
                 state = IDE_DEV_BUSY;
                 status = IDE_STATUS_BUSY;
+                dma_transfer = (feature & 1) ? true : false; /* data phase by bus master DMA */
                 atapi_to_host = (feature >> 2) & 1; /* 0=to device 1=to host */
                 host_maximum_byte_count = ((unsigned int)lba[2] << 8) + (unsigned int)lba[1]; /* LBA field bits 23:8 are byte count */
                 if (host_maximum_byte_count == 0) host_maximum_byte_count = 0x10000UL;
@@ -4127,7 +4243,8 @@ void IDEATAPICDROMDevice::writecommand(uint8_t cmd) {
             if (feature == 0x66/*Disable reverting to power on defaults*/ ||
                 feature == 0xCC/*Enable reverting to power on defaults*/ ||
                 feature == 0x03/*Set transfer mode according to sector count register (required by Linux kernel)*/) {
-                /* ignore */
+                /* remember the transfer mode so IDENTIFY can report it, otherwise ignore */
+                if (feature == 0x03) transfer_mode = (uint8_t)count;
                 status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
                 state = IDE_DEV_READY;
             }
@@ -4282,6 +4399,36 @@ void IDEATADevice::writecommand(uint8_t cmd) {
             status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRQ;
             prepare_write(0UL,512UL*MIN((unsigned long)multiple_sector_count,(unsigned long)(count == 0 ? 256 : count)));
             break;
+        case 0xC8: /* READ DMA */
+        case 0xC9: /* READ DMA WITHOUT RETRY */
+        case 0xCA: /* WRITE DMA */
+        case 0xCB: /* WRITE DMA WITHOUT RETRY */
+            if (!controller->busmaster_enable) {
+                /* no bus master, no DMA. IDENTIFY told the guest as much */
+                LOG_MSG("IDE/ATA DMA command %02X without bus master\n",cmd);
+                abort_error();
+                allow_writing = true;
+                raise_irq();
+                break;
+            }
+
+            command = cmd = (cmd & 0xFE); /* retry or not, it's all the same to us */
+            progress_count = 0;
+            dma_transfer = true;
+            if (cmd == 0xC8) {
+                state = IDE_DEV_BUSY;
+                status = IDE_STATUS_BUSY;
+                PIC_RemoveSpecificEvents(IDE_DelayedCommand,pk);
+                PIC_AddEvent(IDE_DelayedCommand,(faked_command ? 0.000001 : 0.1)/*ms*/,pk);
+            }
+            else {
+                /* like WRITE MULTIPLE the drive asserts DRQ right away, except the bus master answers it */
+                state = IDE_DEV_DATA_WRITE;
+                status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRQ;
+                prepare_write(0UL,512UL*MIN((unsigned long)(sizeof(sector)/512u),(unsigned long)(count == 0 ? 256 : count)));
+                dma_service();
+            }
+            break;
         case 0xC6: /* SET MULTIPLE MODE */
             /* only sector counts 1, 2, 4, 8, 16, 32, 64, and 128 are legal by standard.
              * NTS: There's a bug in VirtualBox that makes 0 legal too! */
@@ -4337,7 +4484,8 @@ void IDEATADevice::writecommand(uint8_t cmd) {
             if (feature == 0x66/*Disable reverting to power on defaults*/ ||
                 feature == 0xCC/*Enable reverting to power on defaults*/ ||
                 feature == 0x03/*Set transfer mode according to sector count register (required by Linux kernel)*/) {
-                /* ignore */
+                /* remember the transfer mode so IDENTIFY can report it, otherwise ignore */
+                if (feature == 0x03) transfer_mode = (uint8_t)count;
                 status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
                 state = IDE_DEV_READY;
             }
@@ -4386,6 +4534,14 @@ IDEController::IDEController(Section* configuration,unsigned char index):Module_
     spindown_timeout = section->Get_int("cd-rom spindown timeout");
     cd_insertion_time = section->Get_int("cd-rom insertion delay");
 
+    /* the PIIX style bus master function only covers the primary and secondary interface */
+    busmaster_enable = section->Get_bool("bus master dma") && index < 2 && !IS_PC98_ARCH && pcibus_enable;
+    bm_command = 0;
+    bm_status = 0;
+    bm_prd = bm_prd_cur = 0;
+    bm_region_addr = bm_region_left = 0;
+    bm_region_eot = false;
+
     host_reset = false;
     irq_pending = false;
     interrupt_enable = true;
@@ -4533,6 +4689,175 @@ IDEController::~IDEController() {
     }
 }
 
+/* PCI bus master IDE function (SFF-8038i, as implemented by the Intel PIIX).
+ * The PCI device in pci_bus.cpp owns the configuration space, and tells us where
+ * BAR4 (16 I/O ports, 8 per channel) is decoded and whether bus mastering is on. */
+static unsigned int ide_busmaster_base = 0;
+static bool ide_busmaster_master_enable = false;
+static IO_ReadHandleObject IDE_BusMaster_ReadHandler[16];
+static IO_WriteHandleObject IDE_BusMaster_WriteHandler[16];
+
+bool IDEController::busmaster_active() {
+    return busmaster_enable && ide_busmaster_master_enable &&
+        (bm_command & IDE_BM_CMD_START) && (bm_status & IDE_BM_STATUS_ACTIVE);
+}
+
+/* move a block between guest physical memory and the device using the PRD table.
+ * system RAM is copied directly, anything else (MMIO, unmapped) goes through the
+ * physical device access functions. */
+static void IDE_BusMaster_MemCopy(PhysPt addr,unsigned char *buf,Bitu len,bool to_memory) {
+    while (len > 0) {
+        const PageNum page = (PageNum)(addr >> 12u);
+        const Bitu pofs = addr & 0xFFFu;
+        const Bitu run = MIN(len,(Bitu)(0x1000u - pofs));
+        PageHandler *ph = MEM_GetPageHandler(page);
+
+        if (to_memory) {
+            if (ph->flags & PFLAG_WRITEABLE)
+                memcpy(ph->GetHostWritePt(page)+pofs,buf,run);
+            else
+                for (Bitu i=0;i < run;i++) physdev_writeb(addr+i,buf[i]);
+        }
+        else {
+            if (ph->flags & PFLAG_READABLE)
+                memcpy(buf,ph->GetHostReadPt(page)+pofs,run);
+            else
+                for (Bitu i=0;i < run;i++) buf[i] = physdev_readb(addr+i);
+        }
+
+        addr += (PhysPt)run;
+        buf += run;
+        len -= run;
+    }
+}
+
+/* returns how many bytes were moved. Less than len means the PRD table ran out,
+ * in which case the bus master stops with an error like real hardware would. */
+Bitu IDEController::busmaster_transfer(unsigned char *buf,Bitu len,bool to_memory) {
+    Bitu done = 0;
+
+    if (!busmaster_active()) return 0;
+
+    if (((bm_command & IDE_BM_CMD_WRITE) != 0) != to_memory)
+        LOG(LOG_MISC,LOG_WARN)("IDE bus master: transfer direction does not match the command");
+
+    while (done < len) {
+        if (bm_region_left == 0) {
+            if (bm_region_eot) {
+                LOG(LOG_MISC,LOG_WARN)("IDE bus master: PRD table smaller than the transfer");
+                bm_status = (bm_status & ~IDE_BM_STATUS_ACTIVE) | IDE_BM_STATUS_ERROR;
+                break;
+            }
+
+            /* fetch the next physical region descriptor */
+            bm_region_addr = physdev_readd(bm_prd_cur) & 0xFFFFFFFEu;
+            bm_region_left = physdev_readw(bm_prd_cur+4u) & 0xFFFEu;
+            if (bm_region_left == 0) bm_region_left = 0x10000u;
+            bm_region_eot = (physdev_readw(bm_prd_cur+6u) & 0x8000u) != 0;
+            bm_prd_cur += 8u;
+        }
+
+        const Bitu run = MIN(len - done,(Bitu)bm_region_left);
+        IDE_BusMaster_MemCopy(bm_region_addr,buf+done,run,to_memory);
+        bm_region_addr += (uint32_t)run;
+        bm_region_left -= (uint32_t)run;
+        done += run;
+    }
+
+    /* the active bit drops when the last region is consumed */
+    if (bm_region_left == 0 && bm_region_eot)
+        bm_status &= ~IDE_BM_STATUS_ACTIVE;
+
+    return done;
+}
+
+static uint8_t ide_busmaster_readb(IDEController *ide,unsigned int reg) {
+    switch (reg) {
+        case 0: return ide->bm_command;
+        case 2: return ide->bm_status;
+        case 4: case 5: case 6: case 7:
+            return (uint8_t)(ide->bm_prd >> ((reg - 4u) * 8u));
+        default: break;
+    }
+
+    return 0x00;
+}
+
+static void ide_busmaster_writeb(IDEController *ide,unsigned int reg,uint8_t val) {
+    switch (reg) {
+        case 0:
+            /* start bit 0->1: (re)load the PRD table and begin. 1->0: abort the transfer */
+            if ((val & IDE_BM_CMD_START) && !(ide->bm_command & IDE_BM_CMD_START)) {
+                ide->bm_status |= IDE_BM_STATUS_ACTIVE;
+                ide->bm_prd_cur = ide->bm_prd;
+                ide->bm_region_addr = ide->bm_region_left = 0;
+                ide->bm_region_eot = false;
+                ide->bm_command = val & (IDE_BM_CMD_START|IDE_BM_CMD_WRITE);
+
+                /* the device may already be waiting with DRQ asserted */
+                IDEDevice *dev = ide->device[ide->select];
+                if (dev != NULL) dev->dma_service();
+            }
+            else {
+                if (!(val & IDE_BM_CMD_START)) ide->bm_status &= ~IDE_BM_STATUS_ACTIVE;
+                ide->bm_command = val & (IDE_BM_CMD_START|IDE_BM_CMD_WRITE);
+            }
+            break;
+        case 2:
+            ide->bm_status &= ~(val & (IDE_BM_STATUS_ERROR|IDE_BM_STATUS_IRQ)); /* write 1 to clear */
+            ide->bm_status = (ide->bm_status & ~IDE_BM_STATUS_DMA_CAPABLE) | (val & IDE_BM_STATUS_DMA_CAPABLE);
+            break;
+        case 4: case 5: case 6: case 7: {
+            const unsigned int shf = (reg - 4u) * 8u;
+            ide->bm_prd = ((ide->bm_prd & ~(0xFFu << shf)) | ((uint32_t)val << shf)) & 0xFFFFFFFCu;
+            break; }
+        default:
+            break;
+    }
+}
+
+static Bitu ide_busmaster_r(Bitu port,Bitu iolen) {
+    Bitu r = 0;
+
+    for (Bitu i=0;i < iolen;i++) {
+        const unsigned int ofs = (unsigned int)(port + i - ide_busmaster_base) & 0xFu;
+        IDEController *ide = idecontroller[ofs >> 3u];
+        r |= (Bitu)(ide != NULL && ide->busmaster_enable ? ide_busmaster_readb(ide,ofs & 7u) : 0xFFu) << (i * 8u);
+    }
+
+    return r;
+}
+
+static void ide_busmaster_w(Bitu port,Bitu val,Bitu iolen) {
+    for (Bitu i=0;i < iolen;i++) {
+        const unsigned int ofs = (unsigned int)(port + i - ide_busmaster_base) & 0xFu;
+        IDEController *ide = idecontroller[ofs >> 3u];
+        if (ide != NULL && ide->busmaster_enable) ide_busmaster_writeb(ide,ofs & 7u,(uint8_t)(val >> (i * 8u)));
+    }
+}
+
+/* called by the PCI device whenever BAR4 or the command register changes */
+void IDE_BusMaster_Configure(unsigned int base,bool io_enable,bool master_enable) {
+    if (!io_enable) base = 0;
+
+    ide_busmaster_master_enable = master_enable;
+    if (ide_busmaster_base == base) return;
+
+    for (unsigned int i=0;i < 16;i++) {
+        IDE_BusMaster_ReadHandler[i].Uninstall();
+        IDE_BusMaster_WriteHandler[i].Uninstall();
+    }
+
+    ide_busmaster_base = base;
+    if (base != 0) {
+        LOG(LOG_MISC,LOG_DEBUG)("IDE bus master I/O at 0x%04x",base);
+        for (unsigned int i=0;i < 16;i++) {
+            IDE_BusMaster_ReadHandler[i].Install(base+i,ide_busmaster_r,IO_MA);
+            IDE_BusMaster_WriteHandler[i].Install(base+i,ide_busmaster_w,IO_MA);
+        }
+    }
+}
+
 static void IDE_PC98_Select(Bitu val) {
     val &= 1;
     pc98_ide_select = val;
@@ -4826,6 +5151,8 @@ static void IDE_Destroy(Section* sec) {
         }
     }
 
+    PCI_RemoveIDEBusMaster_Device();
+
     init_ide = 0;
 }
 
@@ -4856,6 +5183,9 @@ static void IDE_Init(Section* sec,unsigned char ide_interface) {
     ide = idecontroller[ide_interface] = new IDEController(sec,ide_interface);
     ide->install_io_port();
 
+    if (ide->busmaster_enable)
+        PCI_AddIDEBusMaster_Device();
+
     PIC_SetIRQMask((unsigned int)ide->IRQ,false);
 }
 
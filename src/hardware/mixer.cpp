@@ -64,6 +64,24 @@
 #define MIXER_SSIZE 4
 #define MIXER_VOLSHIFT 13
 
+/* SSE2 kernels. SSE2 is always there on x86_64, 32-bit builds check the host CPU */
+#if defined(_M_AMD64) || defined(__amd64__) || defined(__e2k__) || defined(__SSE2__)
+# include <emmintrin.h>
+# define MIXER_SSE2 1
+# define MIXER_SSE2_TARGET
+# define mixer_sse2 (true)
+#elif defined(__SSE__)
+# include <emmintrin.h>
+# define MIXER_SSE2 1
+# if defined(__GNUC__)
+#  define MIXER_SSE2_TARGET __attribute__((__target__("sse2")))
+# else
+#  define MIXER_SSE2_TARGET
+# endif
+extern bool sse2_available;
+# define mixer_sse2 (sse2_available)
+#endif
+
 #ifdef C_SDL2
 SDL_AudioDeviceID SDL2_AudioDevice = 0; /* valid IDs are 2 or higher, 1 for compat, 0 is never a valid ID */
 #endif
@@ -144,8 +162,10 @@ MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * nam
     chan->msbuffer_i = 0;
     chan->msbuffer_o = 0;
     chan->freq_n = chan->freq_d = 1;
+    chan->freq_d_inv = 1.0;
     chan->lowpass_freq = 0;
     chan->lowpass_alpha = 0;
+    chan->lowpass_order = 0;
 
     for (unsigned int i=0;i < LOWPASS_ORDER;i++) {
         for (unsigned int j=0;j < 2;j++)
@@ -252,6 +272,15 @@ void MixerChannel::lowpassUpdate() {
         talpha = timeInterval / (tau + timeInterval);
         lowpass_alpha = (int32_t)(talpha * 0x10000); // double -> 16.16 fixed point
 
+        /* Each stage of the filter is y += a * (x - y). Two of them in a row are the
+         * biquad y[n] = a*a*x[n] + 2*(1-a)*y[n-1] - (1-a)*(1-a)*y[n-2] */
+        const double a = (double)lowpass_alpha / 0x10000;
+        lowpass_biquad[0] = a * a;
+        lowpass_biquad[1] = 2.0 * (1.0 - a);
+        lowpass_biquad[2] = (1.0 - a) * (1.0 - a);
+        lowpass_pole[0] = a;
+        lowpass_pole[1] = 1.0 - a;
+
 //      LOG_MSG("Lowpass freq_n=%u freq_d=%u timeInterval=%.12f tau=%.12f alpha=%.6f onload=%u onout=%u",
 //          freq_n,freq_d_orig,timeInterval,tau,talpha,lowpass_on_load,lowpass_on_out);
     }
@@ -261,18 +290,53 @@ void MixerChannel::lowpassUpdate() {
     }
 }
 
-inline int32_t MixerChannel::lowpassStep(int32_t in,const unsigned int iteration,const unsigned int channel) {
-    const int64_t m1 = (int64_t)in * (int64_t)lowpass_alpha;
-    const int64_t m2 = ((int64_t)lowpass[iteration][channel] << ((int64_t)16)) - ((int64_t)lowpass[iteration][channel] * (int64_t)lowpass_alpha);
-    const int32_t ns = (int32_t)((m1 + m2) >> (int64_t)16);
-    lowpass[iteration][channel] = ns;
-    return ns;
+#if defined(MIXER_SSE2)
+/* Both channels go through the filter together, one in each half of the register */
+MIXER_SSE2_TARGET static void MIXER_LowpassProc_SSE2(int32_t ch[2],double (*state)[2],const unsigned int order,const double biquad[3],const double pole[2]) {
+    __m128d x = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)ch));
+    const __m128d g = _mm_set1_pd(biquad[0]);
+    const __m128d c1 = _mm_set1_pd(biquad[1]);
+    const __m128d c2 = _mm_set1_pd(biquad[2]);
+    unsigned int i = 0;
+
+    for (;(i+2) <= order;i += 2) {
+        const __m128d y1 = _mm_loadu_pd(state[i]);
+        const __m128d y2 = _mm_loadu_pd(state[i+1]);
+        x = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(g,x),_mm_mul_pd(c1,y1)),_mm_mul_pd(c2,y2));
+        _mm_storeu_pd(state[i+1],y1);
+        _mm_storeu_pd(state[i],x);
+    }
+    if (i < order) {
+        const __m128d y1 = _mm_loadu_pd(state[i]);
+        x = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(pole[0]),x),_mm_mul_pd(_mm_set1_pd(pole[1]),y1));
+        _mm_storeu_pd(state[i],x);
+    }
+
+    _mm_storel_epi64((__m128i*)ch,_mm_cvttpd_epi32(x));
 }
+#endif
 
-inline void MixerChannel::lowpassProc(int32_t ch[2]) {
-    for (unsigned int i=0;i < lowpass_order;i++) {
-        for (unsigned int c=0;c < 2;c++)
-            ch[c] = lowpassStep(ch[c],i,c);
+/* lowpass_order one-pole stages, computed two at a time as biquad sections */
+void MixerChannel::lowpassProc(int32_t ch[2]) {
+#if defined(MIXER_SSE2)
+    if (mixer_sse2) {
+        MIXER_LowpassProc_SSE2(ch,lowpass,lowpass_order,lowpass_biquad,lowpass_pole);
+        return;
+    }
+#endif
+    for (unsigned int c=0;c < 2;c++) {
+        double x = ch[c];
+        unsigned int i = 0;
+
+        for (;(i+2) <= lowpass_order;i += 2) {
+            const double y = lowpass_biquad[0] * x + lowpass_biquad[1] * lowpass[i][c] - lowpass_biquad[2] * lowpass[i+1][c];
+            lowpass[i+1][c] = lowpass[i][c];
+            lowpass[i][c] = x = y;
+        }
+        if (i < lowpass_order)
+            lowpass[i][c] = x = lowpass_pole[0] * x + lowpass_pole[1] * lowpass[i][c];
+
+        ch[c] = (int32_t)x;
     }
 }
 
@@ -300,6 +364,7 @@ void MixerChannel::SetFreq(Bitu _freq,Bitu _den) {
 
     freq_n = _freq;
     freq_d = _den * mixer.freq;
+    freq_d_inv = 1.0 / freq_d;
     freq_d_orig = _den;
     updateSlew();
     lowpassUpdate();
@@ -352,6 +417,36 @@ void MixerChannel::EndFrame(Bitu samples) {
     last_sample_write -= (int)samples;
 }
 
+#if defined(MIXER_SSE2)
+MIXER_SSE2_TARGET static void MIXER_Accumulate_SSE2(int32_t *out,const int32_t *in,Bitu frames,const bool swap) {
+    Bitu i = 0;
+    for (;(i+2) <= frames;i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i*2));
+        if (swap) v = _mm_shuffle_epi32(v,_MM_SHUFFLE(2,3,0,1));
+        __m128i *o = (__m128i*)(out + i*2);
+        _mm_storeu_si128(o,_mm_add_epi32(_mm_loadu_si128(o),v));
+    }
+    if (i < frames) {
+        out[i*2+0] += in[i*2+(swap?1:0)];
+        out[i*2+1] += in[i*2+(swap?0:1)];
+    }
+}
+#endif
+
+/* out += in, frames stereo samples, left and right swapped if swap */
+static inline void MIXER_Accumulate(int32_t *out,const int32_t *in,Bitu frames,const bool swap) {
+#if defined(MIXER_SSE2)
+    if (mixer_sse2) {
+        MIXER_Accumulate_SSE2(out,in,frames,swap);
+        return;
+    }
+#endif
+    for (Bitu i=0;i < frames;i++) {
+        out[i*2+0] += in[i*2+(swap?1:0)];
+        out[i*2+1] += in[i*2+(swap?0:1)];
+    }
+}
+
 void MixerChannel::Mix(Bitu whole,Bitu frac) {
     unsigned int patience = 2;
     Bitu upto;
@@ -398,21 +493,11 @@ void MixerChannel::Mix(Bitu whole,Bitu frac) {
         }
     }
 
-    if (mixer.swapstereo) {
-        while (rend_n < whole && msbuffer_i < upto) {
-            *outptr++ += msbuffer[msbuffer_i][1];
-            *outptr++ += msbuffer[msbuffer_i][0];
-            msbuffer_i++;
-            rend_n++;
-        }
-    }
-    else {
-        while (rend_n < whole && msbuffer_i < upto) {
-            *outptr++ += msbuffer[msbuffer_i][0];
-            *outptr++ += msbuffer[msbuffer_i][1];
-            msbuffer_i++;
-            rend_n++;
-        }
+    if (rend_n < whole && msbuffer_i < upto) {
+        const Bitu count = std::min(whole - rend_n,upto - msbuffer_i);
+        MIXER_Accumulate(outptr,msbuffer[msbuffer_i],count,mixer.swapstereo);
+        msbuffer_i += count;
+        rend_n += count;
     }
 
     rend_n = whole;
@@ -531,9 +616,9 @@ inline bool MixerChannel::runSampleInterpolation(const Bitu upto) {
         return false;
 
     while (freq_fslew < freq_d) {
-        int sample = last[0] + (int)(((int64_t)delta[0] * (int64_t)freq_fslew) / (int64_t)freq_d);
+        int sample = last[0] + (int)scaleDelta(delta[0],freq_fslew);
         msbuffer[msbuffer_o][0] = sample * volmul[0];
-        sample = last[1] + (int)(((int64_t)delta[1] * (int64_t)freq_fslew) / (int64_t)freq_d);
+        sample = last[1] + (int)scaleDelta(delta[1],freq_fslew);
         msbuffer[msbuffer_o][1] = sample * volmul[1];
 
         freq_f += freq_n;
@@ -777,6 +862,44 @@ static void MIXER_Mix(void) {
     MIXER_FillUp();
 }
 
+#if defined(MIXER_SSE2)
+/* (in * volscale) >> 26, then clipped, is exact in doubles: the product needs at
+ * most 51 bits, and scaling by 2^-26 only moves the point. Clip first, then add
+ * 32768 so truncation rounds down like the shift does. */
+MIXER_SSE2_TARGET static Bitu MIXER_ScaleClip_SSE2(int16_t *out,const int32_t *in,Bitu frames,int32_t volscale1,int32_t volscale2) {
+    const __m128d vol = _mm_set_pd((double)volscale2 / (1 << (MIXER_VOLSHIFT + MIXER_VOLSHIFT)),(double)volscale1 / (1 << (MIXER_VOLSHIFT + MIXER_VOLSHIFT)));
+    const __m128d lo = _mm_set1_pd(MIN_AUDIO), hi = _mm_set1_pd(MAX_AUDIO);
+    const __m128d bias = _mm_set1_pd(32768.0);
+    const __m128i ibias = _mm_set1_epi32(32768);
+    Bitu i = 0;
+
+    for (;(i+2) <= frames;i += 2) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in + i*2));
+        __m128d a = _mm_mul_pd(_mm_cvtepi32_pd(v),vol);
+        __m128d b = _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(v,_MM_SHUFFLE(1,0,3,2))),vol);
+        a = _mm_add_pd(_mm_min_pd(_mm_max_pd(a,lo),hi),bias);
+        b = _mm_add_pd(_mm_min_pd(_mm_max_pd(b,lo),hi),bias);
+        __m128i r = _mm_unpacklo_epi64(_mm_cvttpd_epi32(a),_mm_cvttpd_epi32(b));
+        r = _mm_sub_epi32(r,ibias);
+        _mm_storel_epi64((__m128i*)(out + i*2),_mm_packs_epi32(r,r));
+    }
+    return i;
+}
+#endif
+
+/* The master volume and clipping, frames stereo samples from in to out */
+void MIXER_ScaleClip(int16_t *out,const int32_t *in,Bitu frames,int32_t volscale1,int32_t volscale2) {
+    Bitu i = 0;
+#if defined(MIXER_SSE2)
+    if (mixer_sse2)
+        i = MIXER_ScaleClip_SSE2(out,in,frames,volscale1,volscale2);
+#endif
+    for (;i < frames;i++) {
+        out[i*2+0] = MIXER_CLIP((((int64_t)in[i*2+0]) * (int64_t)volscale1) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
+        out[i*2+1] = MIXER_CLIP((((int64_t)in[i*2+1]) * (int64_t)volscale2) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
+    }
+}
+
 static void SDLCALL MIXER_CallBack(void * userdata, Uint8 *stream, int len) {
     (void)userdata;//UNUSED
     int32_t volscale1 = (int32_t)(mixer.mastervol[0] * (1 << MIXER_VOLSHIFT));
@@ -802,17 +925,18 @@ static void SDLCALL MIXER_CallBack(void * userdata, Uint8 *stream, int len) {
     }
 
     if (!mixer.prebuffer_wait && !mixer.mute) {
-        int32_t *in = &mixer.work[mixer.work_out][0];
-        while (need > 0) {
-            if (mixer.work_out == mixer.work_in) break;
-            *output++ = MIXER_CLIP((((int64_t)(*in++)) * (int64_t)volscale1) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-            *output++ = MIXER_CLIP((((int64_t)(*in++)) * (int64_t)volscale2) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-            mixer.work_out++;
-            if (mixer.work_out >= mixer.work_wrap) {
+        while (need > 0 && mixer.work_out != mixer.work_in) {
+            /* up to the write position, or the end of the buffer if it has wrapped around */
+            const Bitu end = mixer.work_out < mixer.work_in ? mixer.work_in : mixer.work_wrap;
+            Bitu count = end > mixer.work_out ? end - mixer.work_out : 1;
+            if (count > need) count = need;
+
+            MIXER_ScaleClip(output,&mixer.work[mixer.work_out][0],count,volscale1,volscale2);
+            output += count * 2;
+            need -= count;
+            mixer.work_out += count;
+            if (mixer.work_out >= mixer.work_wrap)
                 mixer.work_out = 0;
-                in = &mixer.work[mixer.work_out][0];
-            }
-            need--;
         }
     }
 
@@ -1616,6 +1616,11 @@ public:
 			return;
 		}
 
+		// poll the backend and send from a network thread, the poller below only
+		// has to hand the queued packets to the NIC
+		if(section->Get_bool("nicthread"))
+			ethernet = OpenEthernetThread(ethernet);
+
 		// get irq and base
 		Bitu irq = (Bitu)section->Get_int("nicirq");
 		if(!(irq==3 || irq==4  || irq==5  || irq==6 ||irq==7 ||
@@ -31,6 +31,7 @@
 #include "../ints/int10.h"
 #include "voodoo.h"
 #include "control.h"
+#include "ide.h"
 
 bool pcibus_enable = false;
 bool log_pci = false;
@@ -352,6 +353,78 @@ public:
 	}
 };
 
+static PCI_Device *IDEBM_PCI=NULL;
+
+/* Bus master IDE function of the Intel 82371SB (PIIX3).
+ * The IDE interfaces remain at their legacy I/O ports and IRQs, this function
+ * only adds the SFF-8038i bus master registers at BAR4 (see ide.cpp). */
+class PCI_IDEBusMasterDevice:public PCI_Device {
+private:
+	static const uint16_t vendor=0x8086;	// Intel
+	static const uint16_t device=0x7010;	// 82371SB PIIX3 IDE
+	void update_busmaster(void) {
+		IDE_BusMaster_Configure(host_readd(config+0x20)&0xfff0u,(config[0x04]&0x01)!=0,(config[0x04]&0x04)!=0);
+	}
+public:
+	PCI_IDEBusMasterDevice():PCI_Device(vendor,device) {
+		config[0x08] = 0x00;	// revision ID
+		config[0x09] = 0x80;	// interface (bus master capable, both channels in legacy mode)
+		config[0x0a] = 0x01;	// subclass type (IDE controller)
+		config[0x0b] = 0x01;	// class type (mass storage controller)
+		config[0x0d] = 0x00;	// latency timer
+		config[0x0e] = 0x00;	// header type (other)
+
+		config[0x3c] = 0xff;	// no irq (legacy IRQ 14/15 are used)
+
+		// reset
+		config[0x04] = 0x05;	// command register (I/O space enabled, bus master enabled)
+		config[0x05] = 0x00;
+		config[0x06] = 0x80;	// status register (fast back-to-back)
+		config[0x07] = 0x02;	// medium DEVSEL timing
+
+		host_writew(config_writemask+0x04,0x0005);	/* allow changing I/O enable and bus master enable */
+		host_writed(config_writemask+0x20,0x0000fff0);	/* BAR4: 16 byte I/O resource */
+		host_writed(config+0x20,0xffa0u | 0x1u);		/* typical BIOS assignment, I/O space */
+
+		/* IDE timing registers, IDE decode enable for both channels */
+		host_writed(config_writemask+0x40,0xffffffffu);
+		config[0x41] = 0x80;
+		config[0x43] = 0x80;
+
+		update_busmaster();
+	}
+
+	~PCI_IDEBusMasterDevice() {
+		/* the PCI bus may delete us on power off, stop decoding the bus master ports */
+		IDE_BusMaster_Configure(0,false,false);
+		if (IDEBM_PCI == this) IDEBM_PCI = NULL;
+	}
+
+	void config_write(uint8_t regnum,Bitu iolen,uint32_t value) override {
+		if (iolen == 1) {
+			const unsigned char mask = config_writemask[regnum];
+			const unsigned char nmask = ~mask;
+
+			config[regnum] = (config[regnum] & nmask) + ((unsigned char)value & mask);
+
+			switch (regnum) {
+				case 0x04:
+				case 0x20:
+				case 0x21:
+				case 0x22:
+				case 0x23:
+					update_busmaster(); /* need to act on the new (masked off) value */
+					break;
+				default:
+					break;
+			}
+		}
+		else {
+			PCI_Device::config_write(regnum,iolen,value); /* which will break down I/O into 8-bit */
+		}
+	}
+};
+
 static bool initialized = false;
 
 static IO_WriteHandleObject PCI_WriteHandler[5];
@@ -541,6 +614,25 @@ void PCI_RemoveSST_Device(void) {
 	}
 }
 
+void PCI_AddIDEBusMaster_Device(void) {
+	if (!pcibus_enable) return;
+
+	if (IDEBM_PCI == NULL) {
+		LOG(LOG_MISC,LOG_DEBUG)("Initializing IDE bus master PCI device");
+		if ((IDEBM_PCI=new PCI_IDEBusMasterDevice()) == NULL)
+			return;
+
+		RegisterPCIDevice(IDEBM_PCI);
+	}
+}
+
+void PCI_RemoveIDEBusMaster_Device(void) {
+	if (IDEBM_PCI != NULL) {
+		UnregisterPCIDevice(IDEBM_PCI);
+		delete IDEBM_PCI; /* destructor clears IDEBM_PCI */
+	}
+}
+
 PhysPt PCI_GetPModeInterface(void) {
 	if (!pcibus_enable) return 0;
 	return GetPModeCallbackPointer();
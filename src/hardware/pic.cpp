@@ -867,6 +867,8 @@ void TIMER_AddTick(void) {
     /* timeout */
     if (time_limit_ms != 0 && PIC_Ticks >= time_limit_ms)
         throw int(1);
+    if (benchmark_instruction_limit != 0 && DOSBOX_BenchmarkInstructions() >= benchmark_instruction_limit)
+        throw int(1);
 
     /* Go through the list of scheduled events and lower their index with 1000 */
     PICEntry * entry=pic_queue.next_entry;
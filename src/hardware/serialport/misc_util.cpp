@@ -140,6 +140,24 @@ bool NETClientSocket::SendByteBuffered(uint8_t val)
 	return SendArray(sendbuffer.data(), sendbuffer.size());
 }
 
+SocketState NETClientSocket::GetcharBuffered(uint8_t &val)
+{
+	if (recvbufferindex >= recvbufferused) {
+		if (recvbuffer.empty())
+			recvbuffer.resize(4096);
+
+		size_t n = recvbuffer.size();
+		recvbufferindex = recvbufferused = 0;
+		const bool open = ReceiveArray(recvbuffer.data(), n);
+		if (n == 0)
+			return open ? SocketState::Empty : SocketState::Closed;
+		recvbufferused = n;
+	}
+
+	val = recvbuffer[recvbufferindex++];
+	return SocketState::Good;
+}
+
 NETServerSocket::NETServerSocket()
 {}
 
@@ -117,11 +117,20 @@ public:
 	void SetSendBufferSize(size_t n);
 	bool SendByteBuffered(uint8_t val);
 
+	// Like GetcharNonBlock, but reads whatever the socket has in one call and
+	// hands it out from a buffer.
+	SocketState GetcharBuffered(uint8_t &val);
+	bool ReceivePending() const { return recvbufferindex < recvbufferused; }
+
 	bool isopen = false;
 
 private:
 	size_t sendbufferindex = 0;
 	std::vector<uint8_t> sendbuffer = {};
+
+	size_t recvbufferindex = 0;
+	size_t recvbufferused = 0;
+	std::vector<uint8_t> recvbuffer = {};
 };
 
 class NETServerSocket {
@@ -29,6 +29,10 @@
 
 extern int socknum;
 
+// time per byte in unthrottled mode. One receive event fills the receive FIFO,
+// so this only gives the guest some time to run between them.
+#define N_UNTHROTTLED_BYTETIME 0.01f
+
 CNullModem::CNullModem(Bitu id, CommandLine* cmd):CSerial (id, cmd) {
 	Bitu temptcpport=23;
 	memset(&telClient, 0, sizeof(telClient));
@@ -50,6 +54,8 @@ CNullModem::CNullModem(Bitu id, CommandLine* cmd):CSerial (id, cmd) {
 	transparent=false;
     nonlocal=false;
 	telnet=false;
+	unthrottled=false;
+	tx_more=false;
 	
 	Bitu bool_temp=0;
 
@@ -89,6 +95,12 @@ CNullModem::CNullModem(Bitu id, CommandLine* cmd):CSerial (id, cmd) {
 			telnet=true;
 		}
 	}
+	// unthrottled: ignore the programmed baud rate. Data is moved into the
+	// receive FIFO and out of the transmit FIFO as fast as the program
+	// handles it, for links that don't need the timing.
+	if (getBituSubstring("unthrottled:", &bool_temp, cmd)) {
+		if (bool_temp==1) unthrottled=true;
+	}
 	// rxdelay: How many milliseconds to wait before causing an
 	// overflow when the application is unresponsive.
 	if (getBituSubstring("rxdelay:", &rx_retry_max, cmd)) {
@@ -186,7 +198,7 @@ void CNullModem::WriteChar(uint8_t data) {
 }
 
 Bits CNullModem::readChar(uint8_t &val) {
-	SocketState state = clientsocket->GetcharNonBlock(val);
+	SocketState state = clientsocket->GetcharBuffered(val);
 	if (state == SocketState::Closed)
 		return -2;
 	if (state != SocketState::Good)
@@ -195,7 +207,7 @@ Bits CNullModem::readChar(uint8_t &val) {
 	if (telnet && rxchar>=0) return TelnetEmulation((uint8_t)rxchar);
 	else if (rxchar==0xff && !transparent) {// escape char
 		// get the next char
-		state = clientsocket->GetcharNonBlock(val);
+		state = clientsocket->GetcharBuffered(val);
 		if (state != SocketState::Good) // 0xff 0xff -> 0xff was meant
 			return -1;
 		Bits rxchar = val;
@@ -218,7 +230,7 @@ bool CNullModem::ClientConnect(NETClientSocket *newsocket) {
 		setCD(false);
 		return false;
 	}
-	clientsocket->SetSendBufferSize(256);
+	clientsocket->SetSendBufferSize(unthrottled ? 4096 : 256);
 	clientsocket->GetRemoteAddressString(peernamebuf);
 	// transmit the line status
 	if (!transparent) setRTSDTR(getRTS(), getDTR());
@@ -261,7 +273,7 @@ bool CNullModem::ServerConnect() {
         return false;
     }
 
-	clientsocket->SetSendBufferSize(256);
+	clientsocket->SetSendBufferSize(unthrottled ? 4096 : 256);
 	rx_state=N_RX_IDLE;
 	setEvent(SERIAL_POLLING_EVENT, 1);
 	
@@ -312,7 +324,7 @@ void CNullModem::handleUpperEvent(uint16_t type) {
 						if (doReceive()) {
 							// a byte was received
 							rx_state=N_RX_WAIT;
-							setEvent(SERIAL_RX_EVENT, bytetime*0.9f);
+							setEvent(SERIAL_RX_EVENT, byteDelay(0.9f));
 						} // else still idle
 					} else {
 #if SERIAL_DEBUG
@@ -320,7 +332,7 @@ void CNullModem::handleUpperEvent(uint16_t type) {
 #endif
 						rx_state=N_RX_BLOCKED;
 						// have both delays (1ms + bytetime)
-						setEvent(SERIAL_RX_EVENT, bytetime*0.9f);
+						setEvent(SERIAL_RX_EVENT, byteDelay(0.9f));
 					}
 					break;
 				case N_RX_BLOCKED:
@@ -335,7 +347,7 @@ void CNullModem::handleUpperEvent(uint16_t type) {
 								// read away everything
 								while(doReceive());
 								rx_state=N_RX_WAIT;
-								setEvent(SERIAL_RX_EVENT, bytetime*0.9f);
+								setEvent(SERIAL_RX_EVENT, byteDelay(0.9f));
 							} else {
 								// much trouble about nothing
                                 rx_state=N_RX_IDLE;
@@ -350,7 +362,7 @@ void CNullModem::handleUpperEvent(uint16_t type) {
 						rx_retry=0;
 						if (doReceive()) {
 							rx_state=N_RX_FASTWAIT;
-							setEvent(SERIAL_RX_EVENT, bytetime*0.65f);
+							setEvent(SERIAL_RX_EVENT, byteDelay(0.65f));
 						} else {
 							// much trouble about nothing
 							rx_state=N_RX_IDLE;
@@ -377,11 +389,11 @@ void CNullModem::handleUpperEvent(uint16_t type) {
 						// just works or unblocked
 						if (doReceive()) {
 							rx_retry=0; // not waiting anymore
-							if (rx_state==N_RX_WAIT) setEvent(SERIAL_RX_EVENT, bytetime*0.9f);
+							if (rx_state==N_RX_WAIT) setEvent(SERIAL_RX_EVENT, byteDelay(0.9f));
 							else {
 								// maybe unblocked
 								rx_state=N_RX_FASTWAIT;
-								setEvent(SERIAL_RX_EVENT, bytetime*0.65f);
+								setEvent(SERIAL_RX_EVENT, byteDelay(0.65f));
 							}
 						} else {
 							// didn't receive anything
@@ -395,7 +407,7 @@ void CNullModem::handleUpperEvent(uint16_t type) {
 							log_ser(dbg_aux,"Nullmodem: rx still blocked (retry=%d)",rx_retry);
 						else log_ser(dbg_aux,"Nullmodem: block on continued rx (retry=%d).",rx_retry);
 #endif
-						setEvent(SERIAL_RX_EVENT, bytetime*0.65f);
+						setEvent(SERIAL_RX_EVENT, byteDelay(0.65f));
 						rx_state=N_RX_BLOCKED;
 					}
 
@@ -409,16 +421,22 @@ void CNullModem::handleUpperEvent(uint16_t type) {
 				if (doReceive()) {
 					// a byte was received
 					rx_state=N_RX_WAIT;
-					setEvent(SERIAL_RX_EVENT, bytetime*0.9f);
+					setEvent(SERIAL_RX_EVENT, byteDelay(0.9f));
 				}
 			}
-			ByteTransmitted();
+			if (unthrottled) {
+				// empty the whole transmit FIFO at once
+				do {
+					tx_more=false;
+					ByteTransmitted();
+				} while (tx_more);
+			} else ByteTransmitted();
 			break;
 		}
 		case SERIAL_THR_EVENT: {
 			ByteTransmitting();
 			// actually send it
-			setEvent(SERIAL_TX_EVENT,bytetime+0.01f);
+			setEvent(SERIAL_TX_EVENT,unthrottled ? N_UNTHROTTLED_BYTETIME : bytetime+0.01f);
 			break;				   
 		}
 		case SERIAL_SERVER_POLLING_EVENT: {
@@ -462,21 +480,32 @@ void CNullModem::updateMSR () {
 }
 
 bool CNullModem::doReceive () {
+	bool received=false;
+	// unthrottled: fill the receive FIFO from what has been read from the
+	// socket already
+	do {
 		uint8_t val;
 		Bits rxchar = readChar(val);
 		if (rxchar>=0) {
 			receiveByteEx((uint8_t)rxchar,0);
-			return true;
+			received=true;
 		}
 		else if (rxchar==-2) {
 			Disconnect();
+			return received;
 		}
-		return false;
+	} while (unthrottled && clientsocket->ReceivePending() && CanReceiveByte());
+	return received;
+}
+
+float CNullModem::byteDelay (float fraction) {
+	return unthrottled ? N_UNTHROTTLED_BYTETIME : bytetime*fraction;
 }
  
 void CNullModem::transmitByte (uint8_t val, bool first) {
  	// transmit it later in THR_Event
-	if (first) setEvent(SERIAL_THR_EVENT, bytetime/8);
+	if (first) setEvent(SERIAL_THR_EVENT, unthrottled ? N_UNTHROTTLED_BYTETIME : bytetime/8);
+	else if (unthrottled) tx_more=true; // sent by the loop in TX_Event
 	else setEvent(SERIAL_TX_EVENT, bytetime);
 
 	// disable 0xff escaping when transparent mode is enabled
@@ -68,6 +68,7 @@ private:
 #define N_RX_DISC		4
 
 	bool doReceive();
+	float byteDelay(float fraction);
 	bool ClientConnect(NETClientSocket * newsocket);
 	bool ServerListen();
 	bool ServerConnect();
@@ -99,6 +100,11 @@ private:
 
 	bool telnet;		// Do Telnet parsing.
 
+	bool unthrottled;	// ignore the baud rate, move data as fast as
+						// the FIFOs are filled and emptied
+	bool tx_more;		// unthrottled: another byte was taken from the
+						// transmit FIFO
+
     bool nonlocal;      // Enable connections NOT originating from localhost
 
 	// Telnet's brain
@@ -1147,6 +1147,7 @@ void VGA_Reset(Section*) {
 	mainMenu.get_item("debug_retracepoll").check(enable_vretrace_poll_debugging_marker).refresh_item(mainMenu);
 
 	VGA_SetupMemory();      // memory is allocated here
+	vga_dirty_tracking = section->Get_bool("skip unchanged scanlines") && vga_dirty.pages != NULL;
 	if (!IS_PC98_ARCH) {
 		VGA_SetupMisc();
 		VGA_SetupDAC();
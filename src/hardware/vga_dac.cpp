@@ -137,6 +137,8 @@ static void VGA_DAC_SendColor( Bitu index, Bitu src ) {
             vga.dac.xlat32[index] = (uint32_t)(blue << 16U) | (uint32_t)(green << 8U) | (uint32_t)(red << 0U);
     }
 
+    /* the SVGA xlat scanline functions convert through the tables above, the renderer never sees the palette change */
+    VGA_DirtyInvalidate();
     RENDER_SetPal( (uint8_t)index, red, green, blue );
 }
 
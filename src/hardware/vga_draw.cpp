@@ -3761,6 +3761,129 @@ void VGA_FreeBiosLogo(void) {
 	BIOSlogo.free();
 }
 
+/* Called at the start of each frame the renderer accepted. Decide whether scanlines whose video memory
+ * was not written since the last frame may be left as the scaler cache already has them, and move the
+ * dirty page bits collected since then into the bitmap consulted during this frame. Only linear SVGA
+ * modes that read video memory straight through are considered, anything else converts every line. */
+static void VGA_DirtyStartFrame(void) {
+    static Bitu last_layout[11] = {0};
+    static VGA_Line_Handler last_drawline = NULL;
+
+    vga_dirty.lines_converted = 0;
+
+    if (!vga_dirty_tracking) {
+        vga_dirty.skip = false;
+        vga_dirty.cursor_bpp = 0;
+        return;
+    }
+
+    /* a palette change is normally applied when the first line is drawn, which is too late to
+     * invalidate this frame. apply it now */
+    VGA_DAC_DeferredUpdateColorPalette();
+
+    /* everything that decides which bytes of video memory end up on which scanline */
+    const Bitu layout[11] = {
+        vga.draw.address,       vga.draw.address_add,   vga.draw.address_line,  vga.draw.address_line_total,
+        vga.draw.line_length,   vga.draw.linear_mask,   vga.draw.split_line,    vga.draw.lines_total,
+        vga.draw.width,         vga.draw.bpp,           vga.draw.panning
+    };
+    const bool same_layout = memcmp(layout,last_layout,sizeof(layout)) == 0 && VGA_DrawLine == last_drawline;
+
+    memcpy(last_layout,layout,sizeof(layout));
+    last_drawline = VGA_DrawLine;
+
+    /* the *_HWMouse handlers draw like their plain counterparts, except on the scanlines the
+     * S3 hardware cursor covers. Those are never skipped, see VGA_DirtySkipLine() */
+    bool supported = true;
+    vga_dirty.cursor_bpp = 0;
+    if (VGA_DrawLine == VGA_Draw_Linear_Line) {
+        vga_dirty.line_bytes = (unsigned int)vga.draw.line_length;
+    }
+    else if (VGA_DrawLine == VGA_Draw_LIN16_Line_HWMouse || VGA_DrawLine == VGA_Draw_LIN32_Line_HWMouse) {
+        vga_dirty.line_bytes = (unsigned int)vga.draw.line_length;
+        vga_dirty.cursor_bpp = (VGA_DrawLine == VGA_Draw_LIN16_Line_HWMouse) ? 2u : 4u;
+    }
+    else if (VGA_DrawLine == VGA_Draw_Linear_Line_24_to_32 || VGA_DrawLine == VGA_Draw_Linear_Line_24_to_32_HWMouse) {
+        vga_dirty.line_bytes = (unsigned int)(vga.draw.width * 3u) + 1u; /* reads one byte past the last pixel */
+        if (VGA_DrawLine == VGA_Draw_Linear_Line_24_to_32_HWMouse) vga_dirty.cursor_bpp = 3u;
+    }
+    else if ((VGA_DrawLine == VGA_Draw_Xlat32_Linear_Line || VGA_DrawLine == VGA_Draw_VGA_Line_Xlat32_HWMouse) && !vga_enable_hretrace_effects) {
+        vga_dirty.line_bytes = (unsigned int)(vga.draw.line_length >> 2u); /* one byte per 32bpp output pixel */
+        if (VGA_DrawLine == VGA_Draw_VGA_Line_Xlat32_HWMouse) vga_dirty.cursor_bpp = 1u;
+    }
+    else {
+        supported = false;
+    }
+
+    /* cursor lines of the last frame must be converted again in case the cursor moved away */
+    vga_dirty.cursor_first = vga_dirty.cursor_seen_first;
+    vga_dirty.cursor_last = vga_dirty.cursor_seen_last;
+    vga_dirty.cursor_seen_first = 1;
+    vga_dirty.cursor_seen_last = 0;
+
+    vga_dirty.skip = same_layout && supported && !vga_dirty.invalidate &&
+        render.frameCached && !render.fullFrame &&
+        vga.draw.linear_base == vga.mem.linear && !video_debug_overlay && !S3SSdraw.draw &&
+        (vga.mode == M_LIN8 || vga.mode == M_LIN15 || vga.mode == M_LIN16 || vga.mode == M_LIN24 || vga.mode == M_LIN32);
+    vga_dirty.invalidate = false;
+
+    if (vga_dirty.skip)
+        memcpy(vga_dirty.pages_frame,vga_dirty.pages,vga_dirty.size);
+    else
+        memset(vga_dirty.pages_frame,0,vga_dirty.size);
+
+    memset(vga_dirty.pages,0,vga_dirty.size);
+}
+
+/* true if the S3 hardware cursor is drawn on the scanline at the current draw address, using the
+ * same test as the *_HWMouse line handlers, or was drawn there last frame. Also remembers the
+ * lines the cursor covers this frame. */
+static bool VGA_DirtyCursorOnLine(void) {
+    const Bitu lineat = ((vga.draw.address-(vga.config.real_start<<2)) / vga_dirty.cursor_bpp) / vga.draw.width;
+
+    if (svga.hardware_cursor_active && svga.hardware_cursor_active() && vga.s3.hgc.posx < vga.draw.width) {
+        const Bitu first = vga.s3.hgc.originy;
+        const Bitu last = vga.s3.hgc.originy + (63U-vga.s3.hgc.posy);
+
+        if (vga_dirty.cursor_seen_first > vga_dirty.cursor_seen_last) {
+            vga_dirty.cursor_seen_first = first;
+            vga_dirty.cursor_seen_last = last;
+        }
+        else {
+            vga_dirty.cursor_seen_first = std::min(vga_dirty.cursor_seen_first,first);
+            vga_dirty.cursor_seen_last = std::max(vga_dirty.cursor_seen_last,last);
+        }
+
+        if (lineat >= first && lineat <= last)
+            return true;
+    }
+
+    return lineat >= vga_dirty.cursor_first && lineat <= vga_dirty.cursor_last;
+}
+
+/* true if the scanline at the current draw address was handed to the renderer unchanged */
+static inline bool VGA_DirtySkipLine(void) {
+    /* checked first so the cursor lines are collected on frames that convert everything too */
+    if (vga_dirty.cursor_bpp != 0u && VGA_DirtyCursorOnLine())
+        return false;
+
+    if (!vga_dirty.skip || vga_page_flip_occurred || vga_3da_polled || (CaptureState & CAPTURE_RAWIMAGE))
+        return false;
+
+    const Bitu start = vga.draw.address & vga.draw.linear_mask;
+    const Bitu end = start + vga_dirty.line_bytes - 1u;
+
+    if (end > vga.draw.linear_mask)
+        return false; /* wraps around to the start of video memory */
+
+    for (Bitu page=start >> 12u;page <= (end >> 12u);page++) {
+        if ((vga_dirty.pages[page >> 3u] | vga_dirty.pages_frame[page >> 3u]) & (1u << (page & 7u)))
+            return false;
+    }
+
+    return RENDER_DrawLineUnchanged();
+}
+
 static void VGA_DrawSingleLine(Bitu /*blah*/) {
     unsigned int lines = 0;
     bool skiprender;
@@ -3867,7 +3990,10 @@ again:
                 vga_3da_polled = false;
             }
             RENDER_DrawLine(TempLine);
+        } else if (VGA_DirtySkipLine()) {
+            /* video memory behind this line has not been written since the last frame, the scaler cache already has it */
         } else {
+            vga_dirty.lines_converted++;
             if ((CaptureState & CAPTURE_RAWIMAGE) && VGA_DrawRawLine && rawshot.capturing) {
                 if (rawshot.render_y < rawshot.image_height && rawshot.image != NULL) {
                     VGA_DrawRawLine(
@@ -6515,6 +6641,8 @@ static void VGA_VerticalTimer(Bitu /*val*/) {
 		// TODO
 	}
 
+	VGA_DirtyStartFrame();
+
 #if 0//DEBUG
 	if (vga.draw.draw_base_size != 0) {
 		LOG(LOG_MISC,LOG_DEBUG)("VGA draw mem planar check 0x%x-0x%x",
@@ -7101,6 +7229,7 @@ void VGA_SetupDrawing(Bitu /*val*/) {
 	// keep compatibility with other builds of DOSBox for vgaonly.
 	is_vga_rendering_on_demand = vga_render_on_demand;
 	vga.draw.must_complete_frame = true;
+	VGA_DirtyInvalidate();
 	vga.draw.doublescan_effect = true;
 	vga.draw.must_draw_again = false;
 	vga.draw.render_step = 0;
@@ -8517,6 +8646,8 @@ void POD_Load_VGA_Draw( std::istream& stream )
 		//case 1: vga.draw.linear_base = vga.fastmem; break;
 	}
 
+	VGA_DirtyInvalidate();
+
 
 	if (IS_EGAVGA_ARCH) {
 		for( int lcv=0; lcv<2; lcv++ ) {
@@ -75,6 +75,10 @@ uint32_t tandy_128kbase = 0x80000;
 int vga_memio_delay_ns = 1000;
 bool vga_memio_lfb_delay = false;
 
+/* track VRAM writes per page so the scanline renderer can skip lines that did not change */
+bool vga_dirty_tracking = false;
+VGA_DirtyPages vga_dirty;
+
 void VGAMEM_USEC_read_delay() {
 	if (vga_memio_delay_ns > 0) {
 		Bits delaycyc = (CPU_CycleMax * vga_memio_delay_ns) / 1000000;
@@ -93,22 +97,37 @@ void VGAMEM_USEC_write_delay() {
 	}
 }
 
+/* mark the VRAM pages behind a write of 'len' bytes through a host pointer mapped handler.
+ * The handler may map something other than VGA memory (Tandy/PCjr system RAM) which is ignored. */
+static inline void vga_dirty_mark_hostpt(PageHandler *p,const PhysPt addr,const unsigned int len) {
+	if (vga_dirty_tracking) {
+		for (PhysPt a=addr;a < (addr+len);a = (a|0xFFFu)+1u) {
+			const HostPt w = &(p->GetHostWritePt(PAGING_GetPhysicalPageNumber(a))[a&0xFFF]);
+			if (w >= vga.mem.linear && w < (vga.mem.linear+vga.mem.memsize))
+				VGA_DirtyMark((uint32_t)(w - vga.mem.linear));
+		}
+	}
+}
+
 template <class baseLFBHandler> class VGA_SlowLFBHandler : public baseLFBHandler {
 	public:
 		VGA_SlowLFBHandler() : baseLFBHandler(PFLAG_NOCODE) {}
 		void writeb(PhysPt addr,uint8_t val) override {
 			VGAMEM_USEC_write_delay();
 			vga_vram_write_trigger_update();
+			vga_dirty_mark_hostpt(this,addr,1);
 			PageHandler_HostPtWriteB(this,addr,val);
 		}
 		void writew(PhysPt addr,uint16_t val) override {
 			VGAMEM_USEC_write_delay();
 			vga_vram_write_trigger_update();
+			vga_dirty_mark_hostpt(this,addr,2);
 			PageHandler_HostPtWriteW(this,addr,val);
 		}
 		void writed(PhysPt addr,uint32_t val) override {
 			VGAMEM_USEC_write_delay();
 			vga_vram_write_trigger_update();
+			vga_dirty_mark_hostpt(this,addr,4);
 			PageHandler_HostPtWriteD(this,addr,val);
 		}
 
@@ -126,6 +145,28 @@ template <class baseLFBHandler> class VGA_SlowLFBHandler : public baseLFBHandler
 		}
 };
 
+/* Same as the LFB handler it wraps, except that writes are not mapped directly so that the
+ * VRAM page can be marked dirty (see VGA_DirtyMark). Reads remain direct. */
+template <class baseLFBHandler> class VGA_DirtyLFBHandler : public baseLFBHandler {
+	public:
+		VGA_DirtyLFBHandler() : baseLFBHandler(PFLAG_READABLE|PFLAG_NOCODE) {}
+		void writeb(PhysPt addr,uint8_t val) override {
+			vga_vram_write_trigger_update();
+			vga_dirty_mark_hostpt(this,addr,1);
+			PageHandler_HostPtWriteB(this,addr,val);
+		}
+		void writew(PhysPt addr,uint16_t val) override {
+			vga_vram_write_trigger_update();
+			vga_dirty_mark_hostpt(this,addr,2);
+			PageHandler_HostPtWriteW(this,addr,val);
+		}
+		void writed(PhysPt addr,uint32_t val) override {
+			vga_vram_write_trigger_update();
+			vga_dirty_mark_hostpt(this,addr,4);
+			PageHandler_HostPtWriteD(this,addr,val);
+		}
+};
+
 template <class Size>
 static INLINE void hostWrite(HostPt off, Bitu val) {
 	if ( sizeof( Size ) == 1)
@@ -382,6 +423,7 @@ template <const bool chained> static inline void VGA_Generic_Write_Handler(PhysP
 	pixels.d|=(data & mask);
 
 	((uint32_t*)vga.mem.linear)[planeaddr]=pixels.d;
+	VGA_DirtyMark(planeaddr << 2u);
 }
 
 // Fast version especially for 256-color mode.
@@ -423,6 +465,7 @@ public:
 	}
 	template <typename T=uint8_t> static INLINE void do_write_aligned(const PhysPt a,const T v) {
 		vga_vram_write_trigger_update();
+		VGA_DirtyMark(a);
 		*((T*)(&vga.mem.linear[a])) = v;
 	}
 	template <typename T=uint8_t> static INLINE void do_write(const PhysPt a,const T v) {
@@ -647,6 +690,7 @@ public:
 		vga_vram_write_trigger_update_planar_mem(addr);
 		((uint32_t*)vga.mem.linear)[addr] =
 			(((uint32_t*)vga.mem.linear)[addr] & vga.config.full_not_map_mask) + (ExpandTable[val] & vga.config.full_map_mask);
+		VGA_DirtyMark(addr << 2u);
 	}
 
 	template <typename T=uint8_t> static INLINE void do_write(const PhysPt a,const T v) {
@@ -2458,6 +2502,7 @@ static struct vg {
 	VGA_SlowLFBHandler<VGA_PC98_LFB_Handler>	map_lfb_pc98_slow;
 	VGA_Map_Handler					map;
 	VGA_SlowLFBHandler<VGA_Map_Handler>		map_slow;
+	VGA_DirtyLFBHandler<VGA_Map_Handler>		map_dirty;
 	VGA_Slow_CGA_Handler				slow;
 	VGA_CGATEXT_PageHandler				cgatext;
 	VGA_MCGATEXT_PageHandler			mcgatext;
@@ -2476,6 +2521,7 @@ static struct vg {
 	HERC_InColor_Graphics_Handler			herc_incolor_graphics;
 	VGA_LFB_Handler					lfb;
 	VGA_SlowLFBHandler<VGA_LFB_Handler>		lfb_slow;
+	VGA_DirtyLFBHandler<VGA_LFB_Handler>		lfb_dirty;
 	VGA_MMIO_Handler				mmio;
 	VGA_AMS_Handler					ams;
 	VGA_PC98_PageHandler				pc98;
@@ -2488,6 +2534,20 @@ static struct vg {
 	VGA_Empty_Handler				empty;
 } vgaph;
 
+/* handler for the banked window / linear framebuffer. Direct mapping is fastest, but writes then
+ * bypass the emulator and can neither be delayed nor tracked for scanline skipping */
+static PageHandler *VGA_MapPageHandler(void) {
+	if (vga_memio_lfb_delay) return &vgaph.map_slow;
+	if (vga_dirty_tracking) return &vgaph.map_dirty;
+	return &vgaph.map;
+}
+
+static PageHandler *VGA_LFBPageHandler(void) {
+	if (vga_memio_lfb_delay) return &vgaph.lfb_slow;
+	if (vga_dirty_tracking) return &vgaph.lfb_dirty;
+	return &vgaph.lfb;
+}
+
 /* backdoor PC-98 memory I/O interface for GDC drawing code in vga_pc98_gdc_draw.cpp.
  * The GDC drawing code must not access video memory through CPU memory I/O functions
  * to avoid needless address translation and possible emulation stability issues that
@@ -2577,7 +2637,7 @@ void VGA_SetupHandlers(void) {
 			 *      software would actually use. */
 			if (vga.herc.enable_bits & 0x1) { /* allow graphics and enable 0xB1000-0xB7FFF */
 				vgapages.mask=0xffff;
-				MEM_SetPageHandler(VGA_PAGE_B0,16,(machine == MCH_HERC && hercCard == HERC_InColor)?(PageHandler*)(&vgaph.herc_incolor_graphics):(PageHandler*)(vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map));
+				MEM_SetPageHandler(VGA_PAGE_B0,16,(machine == MCH_HERC && hercCard == HERC_InColor)?(PageHandler*)(&vgaph.herc_incolor_graphics):VGA_MapPageHandler());
 			}
 			else {
 				vgapages.mask=0xfff;
@@ -2588,7 +2648,7 @@ void VGA_SetupHandlers(void) {
 			// and has MDA-compatible address wrapping when graphics are disabled
 			if (vga.herc.enable_bits & 0x1) {
 				vgapages.mask=0x7fff;
-				MEM_SetPageHandler(VGA_PAGE_B0,16,(machine == MCH_HERC && hercCard == HERC_InColor)?(PageHandler*)(&vgaph.herc_incolor_graphics):(PageHandler*)(vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map));
+				MEM_SetPageHandler(VGA_PAGE_B0,16,(machine == MCH_HERC && hercCard == HERC_InColor)?(PageHandler*)(&vgaph.herc_incolor_graphics):VGA_MapPageHandler());
 			}
 			else {
 				vgapages.mask=0xfff;
@@ -2605,7 +2665,7 @@ void VGA_SetupHandlers(void) {
 		/* Always map 0xa000 - 0xbfff, might overwrite 0xb800 */
 		vgapages.base=VGA_PAGE_A0;
 		vgapages.mask=0x1ffff;
-		MEM_SetPageHandler(VGA_PAGE_A0, 32, vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map );
+		MEM_SetPageHandler(VGA_PAGE_A0, 32, VGA_MapPageHandler() );
 		if ( vga.tandy.extended_ram & 1 ) {
 			//You seem to be able to also map different 64kb banks, but have to figure that out
 			//This seems to work so far though
@@ -2702,7 +2762,7 @@ void VGA_SetupHandlers(void) {
 		case M_LIN24:
 		case M_LIN32:
 		case M_PACKED4:
-			newHandler = vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map;
+			newHandler = VGA_MapPageHandler();
 			break;
 		case M_TEXT:
 		case M_CGA2:
@@ -2721,7 +2781,7 @@ void VGA_SetupHandlers(void) {
 						 * raster op, data rotate, and bit planar features at all. Therefore VGA memory I/O
 						 * performance can be improved by assigning a simplified handler that omits that logic */
 						if (svgaCard == SVGA_TsengET3K || svgaCard == SVGA_TsengET4K)
-							newHandler = vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map;
+							newHandler = VGA_MapPageHandler();
 						else
 							newHandler = &vgaph.cvga;
 					}
@@ -2748,7 +2808,7 @@ void VGA_SetupHandlers(void) {
 					 * emulation this map handler also handles chained 256-color mode
 					 * because of the different way that the memory address is mapped
 					 * to bitplane. */
-					newHandler = vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map;
+					newHandler = VGA_MapPageHandler();
 				}
 			} else {
 				if (vga.complexity.flags == 0 && memio_complexity_optimization && (vga.mode == M_EGA || vga.mode == M_VGA))
@@ -2758,12 +2818,12 @@ void VGA_SetupHandlers(void) {
 			}
 			break;
 		case M_AMSTRAD:
-			newHandler = vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map;
+			newHandler = VGA_MapPageHandler();
 			break;
 	}
 
 	if (vga.dosboxig.svga && !(vga.mode == M_EGA || vga.mode == M_LIN4)/*non-planar modes only*/) {
-		newHandler = vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map;
+		newHandler = VGA_MapPageHandler();
 	}
 
 	// Workaround for ETen Chinese DOS system (e.g. ET24VA)
@@ -2867,7 +2927,7 @@ void VGA_StartUpdateLFB(void) {
 		/* TODO: Perhaps the DOSBox Integrated Device could have an MMIO region */
 		vga.lfb.page = (unsigned int)(S3_LFB_BASE >> 12ul);
 		vga.lfb.addr = (unsigned int)S3_LFB_BASE;
-		vga.lfb.handler = vga_memio_lfb_delay ? &vgaph.lfb_slow : &vgaph.lfb;
+		vga.lfb.handler = VGA_LFBPageHandler();
 		MEM_SetLFB(vga.lfb.page,(unsigned int)vga.mem.memsize/4096u, vga.lfb.handler, NULL);
 		LOG(LOG_MISC,LOG_DEBUG)("DOSBox Integrated Device setting LFB at 0x%lx size 0x%lx",
 			(unsigned long)vga.lfb.addr,(unsigned long)vga.mem.memsize);
@@ -2923,7 +2983,7 @@ void VGA_StartUpdateLFB(void) {
 		else {
 			vga.lfb.page = (unsigned int)(vga.s3.la_window & la_winmsk) << 4u;
 			vga.lfb.addr = (unsigned int)(vga.s3.la_window & la_winmsk) << 16u;
-			vga.lfb.handler = vga_memio_lfb_delay ? &vgaph.lfb_slow : &vgaph.lfb;
+			vga.lfb.handler = VGA_LFBPageHandler();
 			MEM_SetLFB((unsigned int)(vga.s3.la_window & la_winmsk) << 4u,(unsigned int)vga.mem.memsize/4096u, vga.lfb.handler, &vgaph.mmio);
 		}
 	}
@@ -2951,6 +3011,17 @@ static void VGA_Memory_ShutDown(Section * /*sec*/) {
 		vga.mem.linear_orgptr = NULL;
 		vga.mem.linear = NULL;
 	}
+
+	vga_dirty_tracking = false;
+	if (vga_dirty.pages != NULL) {
+		delete[] vga_dirty.pages;
+		vga_dirty.pages = NULL;
+	}
+	if (vga_dirty.pages_frame != NULL) {
+		delete[] vga_dirty.pages_frame;
+		vga_dirty.pages_frame = NULL;
+	}
+	vga_dirty.size = 0;
 }
 
 void VGA_SetupMemory() {
@@ -2964,6 +3035,14 @@ void VGA_SetupMemory() {
         memset(vga.mem.linear_orgptr,0,vga.mem.memsize+32u);
         vga.mem.linear=(uint8_t*)(((uintptr_t)vga.mem.linear_orgptr + 16ull-1ull) & ~(16ull-1ull));
 
+        /* dirty page bitmaps, one bit per 4KB page of the (power of 2) VRAM address space */
+        vga_dirty.size = ((vga.mem.memmask >> 12u) + 8u) >> 3u;
+        vga_dirty.pages = new uint8_t[vga_dirty.size];
+        vga_dirty.pages_frame = new uint8_t[vga_dirty.size];
+        memset(vga_dirty.pages,0,vga_dirty.size);
+        memset(vga_dirty.pages_frame,0,vga_dirty.size);
+        vga_dirty.invalidate = true;
+
         /* HACK. try to avoid stale pointers */
 	    vga.draw.linear_base = vga.mem.linear;
         vga.tandy.draw_base = vga.mem.linear;
@@ -360,23 +360,28 @@ void XGA_DrawPoint(Bitu x, Bitu y, Bitu c) {
 				uint8_t shf = ((memaddr^1u)&1u)*4u;
 				if (GCC_UNLIKELY((memaddr/2) >= vga.mem.memsize)) break;
 				vga.mem.linear[memaddr/2] = (vga.mem.linear[memaddr/2] & (0xF0 >> shf)) + ((c&0xF) << shf);
+				VGA_DirtyMark(memaddr/2);
 			}
 			break;
 		case M_LIN8:
 			if (GCC_UNLIKELY(memaddr >= vga.mem.memsize)) break;
 			vga.mem.linear[memaddr] = (uint8_t)c;
+			VGA_DirtyMark(memaddr);
 			break;
 		case M_LIN15:
 			if (GCC_UNLIKELY(memaddr*2 >= vga.mem.memsize)) break;
 			((uint16_t*)(vga.mem.linear))[memaddr] = (uint16_t)(c&0x7fff);
+			VGA_DirtyMark(memaddr*2);
 			break;
 		case M_LIN16:
 			if (GCC_UNLIKELY(memaddr*2 >= vga.mem.memsize)) break;
 			((uint16_t*)(vga.mem.linear))[memaddr] = (uint16_t)(c&0xffff);
+			VGA_DirtyMark(memaddr*2);
 			break;
 		case M_LIN32:
 			if (GCC_UNLIKELY(memaddr*4 >= vga.mem.memsize)) break;
 			((uint32_t*)(vga.mem.linear))[memaddr] = (uint32_t)c;
+			VGA_DirtyMark(memaddr*4);
 			break;
 		default:
 			break;
@@ -483,6 +488,238 @@ Bitu XGA_GetMixResult(Bitu mixmode, Bitu srcval, Bitu dstdata) {
 	return destval;
 }
 
+/* Span fast paths for the rectangle fill, BitBLT and pattern fill commands.
+ *
+ * Windows 3.x/9x S3 drivers spend most of their time in these commands with a handful of
+ * plain mixes (solid fill, source copy, pattern copy, XOR). If the whole command lies within
+ * the screen pitch and video memory, uses the foreground mix and one of those mixes, it is
+ * carried out a row at a time directly on vga.mem.linear with exactly the result the per-pixel
+ * path (XGA_GetPoint, XGA_GetMixResult, XGA_DrawPoint) would give. Anything else returns
+ * false before touching video memory and takes the per-pixel path. */
+static uint8_t xga_span_buf[4096*4]; /* one row of source pixels, MAPcount is at most 0xFFF */
+
+bool xga_span_disable = false;	/* always take the per-pixel path (for comparing the two in tests) */
+Bitu xga_span_commands = 0;	/* commands carried out by the span paths (statistics) */
+
+template <typename T,const unsigned int mix> static void XGA_SpanMix(T *dst,const T *src,const Bitu sofs,const Bitu smask,const Bitu count,const T wmask) {
+	for (Bitu i=0;i < count;i++) {
+		const T s = src[(i+sofs)&smask];
+		T r;
+
+		switch (mix) {
+			case 0x00: r = (T)~dst[i]; break;		/* not DST */
+			case 0x01: r = (T)0; break;			/* 0 (false) */
+			case 0x02: r = (T)~((T)0); break;		/* 1 (true) */
+			case 0x05: r = (T)(s ^ dst[i]); break;		/* SRC xor DST */
+			default:   r = s; break;			/* SRC */
+		}
+
+		dst[i] = (T)(r & wmask);
+	}
+}
+
+template <typename T> static void XGA_SpanMixRow(const unsigned int mix,T *dst,const T *src,const Bitu sofs,const Bitu smask,const Bitu count,const T wmask) {
+	if (mix == 0x07 && wmask == (T)~((T)0)) {
+		if (smask == ~((Bitu)0)) {
+			memcpy(dst,src+sofs,count*sizeof(T));
+			return;
+		}
+		if (smask == 0u && sizeof(T) == 1) {
+			memset(dst,src[0],count);
+			return;
+		}
+	}
+
+	switch (mix) {
+		case 0x00: XGA_SpanMix<T,0x00>(dst,src,sofs,smask,count,wmask); break;
+		case 0x01: XGA_SpanMix<T,0x01>(dst,src,sofs,smask,count,wmask); break;
+		case 0x02: XGA_SpanMix<T,0x02>(dst,src,sofs,smask,count,wmask); break;
+		case 0x05: XGA_SpanMix<T,0x05>(dst,src,sofs,smask,count,wmask); break;
+		default:   XGA_SpanMix<T,0x07>(dst,src,sofs,smask,count,wmask); break;
+	}
+}
+
+/* bytes per pixel if the span fast paths can carry out the current command with this mix, 0 if not.
+ * XGA_DrawPoint does not apply the write mask and the read mask only matters when video memory
+ * selects the mix (pix_cntl bits 7-6 == 11b), which is left to the per-pixel path. */
+static unsigned int XGA_SpanPixelSize(const Bitu mixmode) {
+	if ((xga.curcommand & 0x11) != 0x11) return 0; /* XGA_DrawPoint would draw nothing */
+
+	switch (mixmode & 0xf) {
+		case 0x00: case 0x01: case 0x02: case 0x05: case 0x07: break;
+		default: return 0;
+	}
+
+	switch (XGA_COLOR_MODE) {
+		case M_LIN8: return 1;
+		case M_LIN15: case M_LIN16: return 2;
+		case M_LIN32: return 4;
+		default: break;
+	}
+
+	return 0;
+}
+
+/* lowest coordinate of a run of count pixels from start in direction d, false if it would go negative */
+static inline bool XGA_SpanLow(const Bitu start,const Bits d,const Bitu count,Bitu &low) {
+	if (d > 0) {
+		low = start;
+		return true;
+	}
+	if ((start + 1u) < count) return false;
+	low = start + 1u - count;
+	return true;
+}
+
+/* true if the w x h rectangle at (x,y) lies within the screen pitch and video memory */
+static inline bool XGA_SpanRectOK(const Bitu x,const Bitu y,const Bitu w,const Bitu h,const unsigned int bpp) {
+	if ((x + w) > XGA_SCREEN_WIDTH) return false;
+	return ((((y + h - 1u) * XGA_SCREEN_WIDTH) + x + w) * bpp) <= vga.mem.memsize;
+}
+
+/* apply the mix to count pixels of row y from x onward, the source pixel for x+i is
+ * src[(i+sofs)&smask]. Clips against the scissors like XGA_DrawPoint. */
+static void XGA_SpanRow(const unsigned int bpp,const unsigned int mix,const Bitu x,const Bitu y,const Bitu count,const uint8_t *src,const Bitu sofs,const Bitu smask) {
+	if (y < xga.scissors.y1 || y > xga.scissors.y2) return;
+
+	const Bitu cx1 = (x > xga.scissors.x1) ? x : xga.scissors.x1;
+	const Bitu cx2 = ((x + count - 1u) < xga.scissors.x2) ? (x + count - 1u) : xga.scissors.x2;
+	if (cx1 > cx2) return;
+
+	const uint32_t ofs = (uint32_t)(((y * XGA_SCREEN_WIDTH) + cx1) * bpp);
+	const Bitu n = cx2 + 1u - cx1;
+	uint8_t *dst = vga.mem.linear + ofs;
+
+	switch (bpp) {
+		case 1:
+			XGA_SpanMixRow<uint8_t>(mix,dst,src,sofs+cx1-x,smask,n,0xFFu);
+			break;
+		case 2:
+			XGA_SpanMixRow<uint16_t>(mix,(uint16_t*)dst,(const uint16_t*)src,sofs+cx1-x,smask,n,
+				(XGA_COLOR_MODE == M_LIN15) ? 0x7FFFu : 0xFFFFu);
+			break;
+		default:
+			XGA_SpanMixRow<uint32_t>(mix,(uint32_t*)dst,(const uint32_t*)src,sofs+cx1-x,smask,n,0xFFFFFFFFu);
+			break;
+	}
+
+	VGA_DirtyMarkRange(ofs,(uint32_t)(n * bpp));
+}
+
+/* put a foreground/background color in the span buffer as a single source pixel */
+static void XGA_SpanColor(const unsigned int bpp,const uint32_t c) {
+	switch (bpp) {
+		case 1: xga_span_buf[0] = (uint8_t)c; break;
+		case 2: *((uint16_t*)xga_span_buf) = (uint16_t)c; break;
+		default: *((uint32_t*)xga_span_buf) = c; break;
+	}
+}
+
+static bool XGA_DrawRectangleSpans(const Bits dx,const Bits dy,const Bitu xrun) {
+	if (xga_span_disable) return false;
+	if (((xga.pix_cntl >> 6) & 0x3) != 0x00) return false;
+
+	const Bitu mixmode = xga.foremix;
+	const unsigned int bpp = XGA_SpanPixelSize(mixmode);
+	if (bpp == 0 || ((mixmode >> 5) & 0x03) > 0x01) return false;
+
+	const Bitu w = xrun + 1u,h = (Bitu)xga.MIPcount + 1u;
+	Bitu x,y;
+
+	if (!XGA_SpanLow(xga.curx,dx,w,x) || !XGA_SpanLow(xga.cury,dy,h,y)) return false;
+	if (!XGA_SpanRectOK(x,y,w,h,bpp)) return false;
+
+	XGA_SpanColor(bpp,((mixmode >> 5) & 0x03) ? xga.forecolor : xga.backcolor);
+	for (Bitu yat=0;yat < h;yat++)
+		XGA_SpanRow(bpp,mixmode & 0xf,x,(Bitu)((Bits)xga.cury + ((Bits)yat * dy)),w,xga_span_buf,0,0);
+
+	xga.curx = (uint16_t)((Bits)xga.curx + ((Bits)w * dx));
+	xga.cury = (uint16_t)((Bits)xga.cury + ((Bits)h * dy));
+	xga_span_commands++;
+	return true;
+}
+
+static bool XGA_BlitRectSpans(const Bits dx,const Bits dy) {
+	if (xga_span_disable) return false;
+	const Bitu mixselect = (xga.pix_cntl >> 6) & 0x3;
+	if (mixselect > 0x01) return false;
+	if (xga.control1 & 0x100) return false; /* COLOR_CMP */
+
+	const Bitu mixmode = (mixselect == 0x00) ? xga.foremix : 0x67;
+	const unsigned int bpp = XGA_SpanPixelSize(mixmode);
+	const Bitu srcsel = (mixmode >> 5) & 0x03;
+	if (bpp == 0 || srcsel == 0x02) return false;
+
+	const Bitu w = (Bitu)xga.MAPcount + 1u,h = (Bitu)xga.MIPcount + 1u;
+	Bitu sx,sy,tx,ty;
+
+	if (!XGA_SpanLow(xga.curx,dx,w,sx) || !XGA_SpanLow(xga.cury,dy,h,sy)) return false;
+	if (!XGA_SpanLow(xga.destx,dx,w,tx) || !XGA_SpanLow(xga.desty,dy,h,ty)) return false;
+	if (!XGA_SpanRectOK(sx,sy,w,h,bpp) || !XGA_SpanRectOK(tx,ty,w,h,bpp)) return false;
+
+	/* Each source row is copied aside before the mix, which matches the per-pixel order unless
+	 * source and destination share rows and overlap in the direction the blit walks. */
+	if (srcsel == 0x03 && sy == ty && (sx > tx ? sx - tx : tx - sx) < w) {
+		if (dx > 0 ? (sx < tx) : (sx > tx)) return false;
+	}
+
+	if (srcsel != 0x03) XGA_SpanColor(bpp,srcsel ? xga.forecolor : xga.backcolor);
+
+	for (Bitu yat=0;yat < h;yat++) {
+		const Bitu srow = (Bitu)((Bits)xga.cury + ((Bits)yat * dy));
+		const Bitu trow = (Bitu)((Bits)xga.desty + ((Bits)yat * dy));
+
+		if (srcsel == 0x03) {
+			memcpy(xga_span_buf,vga.mem.linear + (((srow * XGA_SCREEN_WIDTH) + sx) * bpp),w * bpp);
+			XGA_SpanRow(bpp,mixmode & 0xf,tx,trow,w,xga_span_buf,0,~((Bitu)0));
+		}
+		else {
+			XGA_SpanRow(bpp,mixmode & 0xf,tx,trow,w,xga_span_buf,0,0);
+		}
+	}
+
+	xga_span_commands++;
+	return true;
+}
+
+static bool XGA_DrawPatternSpans(const Bits dx,const Bits dy) {
+	if (xga_span_disable) return false;
+	const Bitu mixselect = (xga.pix_cntl >> 6) & 0x3;
+	if (mixselect > 0x01) return false;
+
+	const Bitu mixmode = (mixselect == 0x00) ? xga.foremix : 0x67;
+	const unsigned int bpp = XGA_SpanPixelSize(mixmode);
+	const Bitu srcsel = (mixmode >> 5) & 0x03;
+	if (bpp == 0 || srcsel == 0x02) return false;
+
+	const Bitu w = (Bitu)xga.MAPcount + 1u,h = (Bitu)xga.MIPcount + 1u;
+	const Bitu px = xga.curx,py = xga.cury;
+	Bitu tx,ty;
+
+	if (!XGA_SpanLow(xga.destx,dx,w,tx) || !XGA_SpanLow(xga.desty,dy,h,ty)) return false;
+	if (!XGA_SpanRectOK(tx,ty,w,h,bpp) || !XGA_SpanRectOK(px,py,8,8,bpp)) return false;
+
+	/* the 8x8 pattern must not be drawn over by the fill itself */
+	if (srcsel == 0x03 && px < (tx + w) && tx < (px + 8u) && py < (ty + h) && ty < (py + 8u)) return false;
+
+	if (srcsel != 0x03) XGA_SpanColor(bpp,srcsel ? xga.forecolor : xga.backcolor);
+
+	for (Bitu yat=0;yat < h;yat++) {
+		const Bitu trow = (Bitu)((Bits)xga.desty + ((Bits)yat * dy));
+
+		if (srcsel == 0x03) {
+			memcpy(xga_span_buf,vga.mem.linear + ((((py + (trow & 7u)) * XGA_SCREEN_WIDTH) + px) * bpp),8u * bpp);
+			XGA_SpanRow(bpp,mixmode & 0xf,tx,trow,w,xga_span_buf,tx & 7u,7u);
+		}
+		else {
+			XGA_SpanRow(bpp,mixmode & 0xf,tx,trow,w,xga_span_buf,0,0);
+		}
+	}
+
+	xga_span_commands++;
+	return true;
+}
+
 void XGA_DrawLineVector(Bitu val) {
 	Bits xat, yat;
 	Bitu srcval;
@@ -759,6 +996,8 @@ void XGA_DrawRectangle(Bitu val) {
 		else return;
 	}
 
+	if (XGA_DrawRectangleSpans(dx,dy,xrun)) return;
+
 	for(yat=0;yat<=xga.MIPcount;yat++) {
 		srcx = xga.curx;
 		for(xat=0;xat<=xrun;xat++) {
@@ -1039,6 +1278,8 @@ void XGA_BlitRect(Bitu val) {
 	if(((val >> 5) & 0x01) != 0) dx = 1;
 	if(((val >> 7) & 0x01) != 0) dy = 1;
 
+	if (XGA_BlitRectSpans(dx,dy)) return;
+
 	colorcmpdata = xga.color_compare & XGA_PointMask();
 
 	srcx = xga.curx;
@@ -1144,6 +1385,8 @@ void XGA_DrawPattern(Bitu val) {
 	if(((val >> 5) & 0x01) != 0) dx = 1;
 	if(((val >> 7) & 0x01) != 0) dy = 1;
 
+	if (XGA_DrawPatternSpans(dx,dy)) return;
+
 	srcx = xga.curx;
 	srcy = xga.cury;
 
@@ -1594,15 +1837,19 @@ void XGA_DrawVirgePixel(XGAStatus::XGA_VirgeState::reggroup &rset,unsigned int x
 			memaddr = (uint32_t)((y * rset.dst_stride) + x) + rset.dst_base;
 			if (GCC_UNLIKELY(memaddr >= vga.mem.memsize)) break;
 			vga.mem.linear[memaddr] = (uint8_t)c;
+			VGA_DirtyMark(memaddr);
 			break;
 		case 1: // 16 bits/pixel
 			memaddr = (uint32_t)((y * rset.dst_stride) + (x*2)) + rset.dst_base;
 			if (GCC_UNLIKELY(memaddr >= vga.mem.memsize)) break;
 			*((uint16_t*)(vga.mem.linear+memaddr)) = (uint16_t)(c&0xffff);
+			VGA_DirtyMark(memaddr);
 			break;
 		case 2: // 24/32 bits/pixel
 			memaddr = (uint32_t)((y * rset.dst_stride) + (x*xga.virge.truecolor_bypp)) + rset.dst_base;
 			if (GCC_UNLIKELY(memaddr >= vga.mem.memsize)) break;
+			VGA_DirtyMark(memaddr);
+			VGA_DirtyMark(memaddr+3u); /* 24bpp pixels can straddle a page */
 			if (xga.virge.truecolor_mask == 0xFFFFFFFFu) {
 				*((uint32_t*)(vga.mem.linear+memaddr)) = (uint32_t)c;
 			}
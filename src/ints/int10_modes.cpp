@@ -933,6 +933,7 @@ static void FinishSetMode(bool clearmem) {
         case M_PACKED4:
 			/* Hack we just access the memory directly */
 			memset(vga.mem.linear,0,vga.mem.memsize);
+			VGA_DirtyInvalidate();
 			break;
 		default:
 			break;
@@ -27,6 +27,13 @@
 #include "dosbox.h"
 #include "control.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
 EthernetConnection* OpenEthernetConnection(std::string backendstr)
 {
     EthernetConnection* conn = nullptr;
@@ -84,3 +91,163 @@ EthernetConnection* OpenEthernetConnection(std::string backendstr)
 
     return conn;
 }
+
+/* Single producer, single consumer queue of Ethernet frames. Each side only
+ * writes its own index, so neither ever waits on the other. */
+class EthernetFrameQueue
+{
+    public:
+        EthernetFrameQueue() : head(0), tail(0) {}
+
+        bool Push(const uint8_t* packet, int len)
+        {
+            const unsigned int pos = tail.load(std::memory_order_relaxed);
+            if (len < 0 || len > (int)sizeof(slots[0].data)) return false;
+            if (pos - head.load(std::memory_order_acquire) >= SLOTS) return false;
+
+            Slot& slot = slots[pos % SLOTS];
+            slot.len = len;
+            memcpy(slot.data, packet, (size_t)len);
+            tail.store(pos + 1u, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(const std::function<void(const uint8_t*, int)>& callback)
+        {
+            const unsigned int pos = head.load(std::memory_order_relaxed);
+            if (pos == tail.load(std::memory_order_acquire)) return false;
+
+            const Slot& slot = slots[pos % SLOTS];
+            callback(slot.data, slot.len);
+            head.store(pos + 1u, std::memory_order_release);
+            return true;
+        }
+
+        bool Empty() const
+        {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        static const unsigned int SLOTS = 256;
+
+        struct Slot {
+            int len;
+            uint8_t data[2048]; /* an Ethernet frame is 1514 bytes without the CRC */
+        };
+
+        Slot slots[SLOTS];
+        alignas(64) std::atomic<unsigned int> head;
+        alignas(64) std::atomic<unsigned int> tail;
+};
+
+class ThreadedEthernetConnection : public EthernetConnection
+{
+    public:
+        ThreadedEthernetConnection(EthernetConnection* backend) : backend(backend), run(false), idle(false) {}
+
+        ~ThreadedEthernetConnection() override
+        {
+            if (thread.joinable()) {
+                run.store(false);
+                Wake();
+                thread.join();
+            }
+            delete backend;
+        }
+
+        bool Initialize(Section* config) override
+        {
+            (void)config;//UNUSED
+            run.store(true);
+            try {
+                thread = std::thread(&ThreadedEthernetConnection::Run, this);
+            }
+            catch (const std::system_error&) {
+                run.store(false);
+                return false;
+            }
+            return true;
+        }
+
+        void SendPacket(const uint8_t* packet, int len) override
+        {
+            if (!tx.Push(packet, len)) return;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (idle.load()) Wake();
+        }
+
+        void GetPackets(std::function<void(const uint8_t*, int)> callback) override
+        {
+            while (rx.Pop(callback));
+        }
+
+        /* Hands the backend back, so that deleting this connection leaves it open */
+        EthernetConnection* Release()
+        {
+            EthernetConnection* ret = backend;
+            backend = nullptr;
+            return ret;
+        }
+
+    private:
+        void Wake()
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            wake.notify_one();
+        }
+
+        void Run()
+        {
+            const std::function<void(const uint8_t*, int)> send = [this](const uint8_t* packet, int len) {
+                backend->SendPacket(packet, len);
+            };
+
+            while (run.load()) {
+                bool busy = false;
+
+                while (tx.Pop(send)) busy = true;
+                backend->GetPackets([this, &busy](const uint8_t* packet, int len) {
+                    rx.Push(packet, len);
+                    busy = true;
+                });
+
+                if (busy) continue;
+
+                /* Nothing to do. The backends do not block in GetPackets, so
+                 * sleep until a packet is queued to send or the next poll. */
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                idle.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (tx.Empty() && run.load())
+                    wake.wait_for(lock, std::chrono::microseconds(250));
+                idle.store(false);
+            }
+        }
+
+        EthernetConnection* backend;
+        EthernetFrameQueue rx, tx;
+        std::atomic<bool> run, idle;
+        std::thread thread;
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+};
+
+EthernetConnection* OpenEthernetThread(EthernetConnection* backend)
+{
+#if C_EMSCRIPTEN
+    return backend; /* no threads */
+#else
+    if (!backend) return nullptr;
+
+    ThreadedEthernetConnection* conn = new ThreadedEthernetConnection(backend);
+    if (!conn->Initialize(nullptr)) {
+        LOG_MSG("ETHERNET: Unable to start the network thread, polling from the emulator");
+        conn->Release();
+        delete conn;
+        return backend;
+    }
+
+    return conn;
+#endif
+}
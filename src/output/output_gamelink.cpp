@@ -174,12 +174,6 @@ Bitu OUTPUT_GAMELINK_SetSize()
     sdl.clip.x = 0;
     sdl.clip.y = 0;
 
-    // FIXME: Please use sdl.draw.width and sdl.draw.height and allocate based on that.
-    //        Free the buffer and reallocate on size change. Look at the OpenGL output
-    //        code for a good example.
-    if (!sdl.gamelink.framebuf) {
-        sdl.gamelink.framebuf = malloc(SCALER_MAXWIDTH * SCALER_MAXHEIGHT * 4);   // 32 bit color frame buffer
-    }
     sdl.gamelink.pitch = sdl.draw.width*4;
 
     sdl.desktop.type = SCREEN_GAMELINK;
@@ -205,7 +199,10 @@ Bitu OUTPUT_GAMELINK_SetSize()
     }
 #endif
 
-    if (sdl.clip.w > GameLink::sSharedMMapFrame_R1::MAX_WIDTH || sdl.clip.h > GameLink::sSharedMMapFrame_R1::MAX_HEIGHT) {
+    const bool ring = sdl.gamelink.protocol >= 5;
+    const int max_width = ring ? GameLink::sSharedMMapFrameSlot_R5::MAX_WIDTH : GameLink::sSharedMMapFrame_R1::MAX_WIDTH;
+    const int max_height = ring ? GameLink::sSharedMMapFrameSlot_R5::MAX_HEIGHT : GameLink::sSharedMMapFrame_R1::MAX_HEIGHT;
+    if (sdl.clip.w > max_width || sdl.clip.h > max_height) {
 #ifdef WIN32
         MessageBoxA( NULL, "ERROR: Game Link output resolution too big (windowresolution).",
                                 "DOSBox \"Game Link\" Error", MB_OK | MB_ICONSTOP );
@@ -216,6 +213,16 @@ Bitu OUTPUT_GAMELINK_SetSize()
         return 0;
     }
 
+    // 32 bit color frame buffer, reallocated when the frame outgrows it
+    const size_t framebuf_size = (size_t)sdl.gamelink.pitch * (size_t)sdl.clip.h;
+    if (sdl.gamelink.framebuf == NULL || sdl.gamelink.framebuf_size < framebuf_size) {
+        free(sdl.gamelink.framebuf);
+        sdl.gamelink.framebuf = calloc(framebuf_size, 1);
+        sdl.gamelink.framebuf_size = sdl.gamelink.framebuf ? framebuf_size : 0;
+        if (sdl.gamelink.framebuf == NULL)
+            E_Exit("GAMELINK: Out of memory for a %ix%i frame", (int)sdl.clip.w, (int)sdl.clip.h);
+    }
+
     sdl.deferred_resize = false;
     sdl.must_redraw_all = true;
 
@@ -274,6 +281,9 @@ void OUTPUT_GAMELINK_EndUpdate(const uint16_t *changedLines)
 #if C_XBRZ
     if (sdl_xbrz.enable && sdl_xbrz.scale_on)
     {
+        // the scaled lines do not map to the rendered ones
+        GameLink::Changed(NULL, (uint16_t)sdl.clip.h);
+
         const uint32_t srcWidth = sdl.draw.width;
         const uint32_t srcHeight = sdl.draw.height;
         if (sdl_xbrz.renderbuf.size() == (unsigned int)srcWidth * (unsigned int)srcHeight && srcWidth > 0 && srcHeight > 0)
@@ -304,7 +314,10 @@ void OUTPUT_GAMELINK_EndUpdate(const uint16_t *changedLines)
 
         }
     }
+    else
 #endif /*C_XBRZ*/
+    if (changedLines != NULL) // NULL: nothing changed
+        GameLink::Changed(changedLines, (uint16_t)sdl.clip.h);
     if (!menu.hidecycles) frames++;
     SDL_UpdateWindowSurface(sdl.window);
 }
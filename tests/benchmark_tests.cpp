@@ -0,0 +1,87 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "dosbox.h"
+#include "callback.h"
+#include "pic.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+namespace {
+
+class BenchmarkTest : public DOSBoxTestFixture {
+public:
+	void TearDown() override
+	{
+		benchmark_mode = false;
+	}
+
+	// Run the idle loop for ms of emulated time, returns the host seconds it took
+	static double RunEmulated(double ms)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const double end = PIC_FullIndex() + ms;
+		while (PIC_FullIndex() < end)
+			CALLBACK_Idle();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// The number after "name": in the report, or -1
+	static double Field(const std::string &report, const char *name)
+	{
+		const std::string key = std::string("\"") + name + "\": ";
+		const size_t pos = report.find(key);
+		return pos == std::string::npos ? -1 : strtod(report.c_str() + pos + key.size(), NULL);
+	}
+};
+
+TEST_F(BenchmarkTest, CountsTheWorkDoneWithoutPacing)
+{
+	DOSBOX_BenchmarkReset();
+	benchmark_mode = true;
+	const double seconds = RunEmulated(1000);
+	benchmark_mode = false;
+
+	const std::string report = DOSBOX_BenchmarkReport();
+	printf("%s", report.c_str());
+
+	// one emulated second, done faster than real time
+	EXPECT_LT(seconds, 1.0);
+	EXPECT_NEAR(Field(report, "emulated_ms"), 1000.0, 2.0);
+	EXPECT_NE(report.find("\"stop\": \"exit\""), std::string::npos);
+
+	// the idle loop runs on the normal core for all the cycles it is given
+	EXPECT_GE(Field(report, "cycles"), Field(report, "instructions"));
+	EXPECT_GT(Field(report, "instructions"), 0.9 * 1000 * Field(report, "cycles_per_ms"));
+	EXPECT_NE(report.find("\"normal\": {"), std::string::npos);
+
+	// a second of 60-70Hz video and of mixer output
+	EXPECT_GE(Field(report, "frames"), 55.0);
+	EXPECT_LE(Field(report, "frames"), 75.0);
+	EXPECT_GT(Field(report, "audio_samples"), 8000.0);
+}
+
+} // namespace
@@ -0,0 +1,362 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "dosbox.h"
+#include "cpu.h"
+#include "dos_inc.h"
+#include "mem.h"
+#include "paging.h"
+#include "regs.h"
+
+#include <chrono>
+#include <initializer_list>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+Bitu FillFlags(void);
+#if C_DYNAMIC_X86
+void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache);
+#endif
+#if C_DYNREC
+void CPU_Core_Dynrec_Cache_Init(bool enable_cache);
+#endif
+
+namespace {
+
+// Guest code is assembled by hand into a 64KB segment aligned to a page:
+//   0000h  kernel data, 0100h GDTR and GDT
+//   1000h  source buffer, 2000h destination buffer
+//   3000h  page directory, 4000h page table (first 4MB mapped 1:1)
+//   8000h  code, one page per CPU core so the dynamic cores never share one
+const uint16_t GDT_OFFSET = 0x100;
+const uint16_t PAGE_DIR_OFFSET = 0x3000;
+const uint16_t PAGE_TABLE_OFFSET = 0x4000;
+const uint16_t CODE_OFFSET = 0x8000;
+
+struct Code {
+	Code(uint16_t org, uint16_t seg) : org(org), seg(seg) {}
+
+	uint16_t Here() const { return (uint16_t)(org + bytes.size()); }
+	void B(std::initializer_list<int> list) { for (int v : list) bytes.push_back((uint8_t)v); }
+	void W(uint32_t v) { B({ (int)(v & 0xFF), (int)((v >> 8) & 0xFF) }); }
+	void D(uint32_t v) { W(v); W(v >> 16); }
+	void Jmp(uint16_t target) { B({ 0xEB, (int)(uint8_t)(target - (Here() + 2)) }); }
+	void JmpFar(uint16_t sel) { B({ 0xEA }); W(Here() + 4u); W(sel); } // to the next instruction
+
+	uint16_t org, seg;
+	std::vector<uint8_t> bytes;
+};
+
+struct Kernel {
+	const char* name;
+	bool mode_switch; // enters protected mode, so it needs real mode to begin with
+	void (*build)(Code& c);
+};
+
+void BuildALU(Code& c)
+{
+	const uint16_t loop = c.Here();
+	c.B({ 0x01, 0xD8 }); // add ax,bx
+	c.B({ 0x31, 0xC2 }); // xor dx,ax
+	c.B({ 0xD1, 0xE0 }); // shl ax,1
+	c.B({ 0x11, 0xD1 }); // adc cx,dx
+	c.B({ 0x43 });       // inc bx
+	c.Jmp(loop);
+}
+
+void BuildRepString(Code& c)
+{
+	c.B({ 0xFC }); // cld
+	const uint16_t loop = c.Here();
+	c.B({ 0xB9, 0x00, 0x01 });       // mov cx,256
+	c.B({ 0xBE, 0x00, 0x10 });       // mov si,1000h
+	c.B({ 0xBF, 0x00, 0x20 });       // mov di,2000h
+	c.B({ 0xF3, 0xA5 });             // rep movsw
+	c.B({ 0xB9, 0x00, 0x01 });       // mov cx,256
+	c.B({ 0xBF, 0x00, 0x20 });       // mov di,2000h
+	c.B({ 0x66, 0xF3, 0xAB });       // rep stosd
+	c.Jmp(loop);
+}
+
+void BuildFPU(Code& c)
+{
+	c.B({ 0xDB, 0xE3 }); // fninit
+	const uint16_t loop = c.Here();
+	c.B({ 0xD9, 0x06, 0x00, 0x00 }); // fld dword [0]
+	c.B({ 0xD8, 0xC8 });             // fmul st0,st0
+	c.B({ 0xD9, 0xFA });             // fsqrt
+	c.B({ 0xD8, 0x06, 0x04, 0x00 }); // fadd dword [4]
+	c.B({ 0xD9, 0x1E, 0x08, 0x00 }); // fstp dword [8]
+	c.Jmp(loop);
+}
+
+void BuildMMX(Code& c)
+{
+	const uint16_t loop = c.Here();
+	c.B({ 0x0F, 0x6F, 0x06, 0x10, 0x00 }); // movq mm0,[10h]
+	c.B({ 0x0F, 0xFC, 0x06, 0x18, 0x00 }); // paddb mm0,[18h]
+	c.B({ 0x0F, 0xD5, 0xC0 });             // pmullw mm0,mm0
+	c.B({ 0x0F, 0xEF, 0xC8 });             // pxor mm1,mm0
+	c.B({ 0x0F, 0x7F, 0x0E, 0x20, 0x00 }); // movq [20h],mm1
+	c.Jmp(loop);
+}
+
+void BuildFarCallIret(Code& c)
+{
+	c.B({ 0xEB, 0x01 }); // jmp over the far procedure
+	const uint16_t proc = c.Here();
+	c.B({ 0xCB });       // retf
+	const uint16_t loop = c.Here();
+	c.B({ 0x9A }); c.W(proc); c.W(c.seg); // call far seg:proc
+	c.B({ 0x9C });       // pushf
+	c.B({ 0x0E });       // push cs
+	c.B({ 0x68 }); c.W(c.Here() + 3u);    // push offset of the jmp after iret
+	c.B({ 0xCF });       // iret
+	c.Jmp(loop);
+}
+
+void BuildModeSwitch(Code& c)
+{
+	c.B({ 0x0F, 0x01, 0x16 }); c.W(GDT_OFFSET); // lgdt [GDT_OFFSET]
+	const uint16_t loop = c.Here();
+	c.B({ 0x0F, 0x20, 0xC0 }); // mov eax,cr0
+	c.B({ 0x0C, 0x01 });       // or al,1
+	c.B({ 0x0F, 0x22, 0xC0 }); // mov cr0,eax
+	c.JmpFar(0x08);            // jmp 08h:next
+	c.B({ 0xB8, 0x10, 0x00 }); // mov ax,10h
+	c.B({ 0x8E, 0xD8 });       // mov ds,ax
+	c.B({ 0x0F, 0x20, 0xC0 }); // mov eax,cr0
+	c.B({ 0x24, 0xFE });       // and al,0FEh
+	c.B({ 0x0F, 0x22, 0xC0 }); // mov cr0,eax
+	c.JmpFar(c.seg);           // jmp seg:next
+	c.B({ 0x8C, 0xC8 });       // mov ax,cs
+	c.B({ 0x8E, 0xD8 });       // mov ds,ax
+	c.Jmp(loop);
+}
+
+void BuildMemoryLoop(Code& c)
+{
+	c.B({ 0x31, 0xF6 }); // xor si,si
+	const uint16_t loop = c.Here();
+	c.B({ 0x66, 0x8B, 0x84, 0x00, 0x10 }); // mov eax,[si+1000h]
+	c.B({ 0x66, 0x01, 0x84, 0x00, 0x20 }); // add [si+2000h],eax
+	c.B({ 0x83, 0xC6, 0x04 });             // add si,4
+	c.B({ 0x81, 0xE6, 0xFC, 0x0F });       // and si,0FFCh
+	c.Jmp(loop);
+}
+
+void BuildPagedMemoryLoop(Code& c)
+{
+	c.B({ 0x0F, 0x01, 0x16 }); c.W(GDT_OFFSET);  // lgdt [GDT_OFFSET]
+	c.B({ 0x66, 0xB8 }); c.D(c.seg * 16u + PAGE_DIR_OFFSET); // mov eax,page directory
+	c.B({ 0x0F, 0x22, 0xD8 });                     // mov cr3,eax
+	c.B({ 0x0F, 0x20, 0xC0 });                     // mov eax,cr0
+	c.B({ 0x66, 0x0D, 0x01, 0x00, 0x00, 0x80 });   // or eax,80000001h
+	c.B({ 0x0F, 0x22, 0xC0 });                     // mov cr0,eax
+	c.JmpFar(0x08);                                // jmp 08h:next
+	c.B({ 0xB8, 0x10, 0x00 });                     // mov ax,10h
+	c.B({ 0x8E, 0xD8 });                           // mov ds,ax
+	BuildMemoryLoop(c);
+}
+
+const Kernel kernels[] = {
+	{ "alu",          false, BuildALU },
+	{ "rep_string",   false, BuildRepString },
+	{ "fpu",          false, BuildFPU },
+	{ "mmx",          false, BuildMMX },
+	{ "far_call",     false, BuildFarCallIret },
+	{ "mode_switch",  true,  BuildModeSwitch },
+	{ "memory",       false, BuildMemoryLoop },
+	{ "memory_paged", true,  BuildPagedMemoryLoop },
+};
+
+struct Core {
+	const char* name;
+	CPU_Decoder* run;
+};
+
+const Core cores[] = {
+	{ "normal",   CPU_Core_Normal_Run },
+	{ "simple",   CPU_Core_Simple_Run },
+	{ "prefetch", CPU_Core_Prefetch_Run },
+#if C_DYNREC
+	{ "dynrec",   CPU_Core_Dynrec_Run },
+#endif
+#if C_DYNAMIC_X86
+	{ "dyn_x86",  CPU_Core_Dyn_X86_Run },
+#endif
+};
+
+class CPUCoreTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		uint16_t blocks = 0x1100; // 64KB plus room to align it to a page
+		ASSERT_TRUE(DOS_AllocateMemory(&block, &blocks));
+		seg = (uint16_t)((block + 0xFF) & ~0xFF);
+		const PhysPt base = (PhysPt)seg * 16u;
+
+		// kernel data: two floats, two MMX operands, and buffers
+		const float f[2] = { 1.5f, 0.25f };
+		for (unsigned int i = 0; i < 2; i++) {
+			uint32_t v;
+			memcpy(&v, &f[i], sizeof(v));
+			phys_writed(base + i * 4, v);
+		}
+		for (unsigned int i = 0; i < 16; i++)
+			phys_writeb(base + 0x10 + i, (uint8_t)(i * 17 + 3));
+		for (unsigned int i = 0; i < 0x2000; i++)
+			phys_writeb(base + 0x1000 + i, (uint8_t)i);
+
+		// GDTR, then a null descriptor and 16-bit code and data segments at seg:0
+		phys_writew(base + GDT_OFFSET, 0x17);
+		phys_writed(base + GDT_OFFSET + 2, base + GDT_OFFSET + 8);
+		for (unsigned int i = 0; i < 3; i++) {
+			const PhysPt d = base + GDT_OFFSET + 8 + i * 8;
+			phys_writed(d, i ? ((base & 0xFFFF) << 16) | 0xFFFF : 0);
+			phys_writed(d + 4, i ? (base & 0xFF000000) | ((i == 1 ? 0x9A : 0x92) << 8) | ((base >> 16) & 0xFF) : 0);
+		}
+
+		phys_writed(base + PAGE_DIR_OFFSET, (base + PAGE_TABLE_OFFSET) | 3);
+		for (unsigned int i = 1; i < 1024; i++)
+			phys_writed(base + PAGE_DIR_OFFSET + i * 4, 0);
+		for (unsigned int i = 0; i < 1024; i++)
+			phys_writed(base + PAGE_TABLE_OFFSET + i * 4, (i << 12) | 3);
+
+#if C_DYNAMIC_X86
+		CPU_Core_Dyn_X86_Cache_Init(true);
+#endif
+#if C_DYNREC
+		CPU_Core_Dynrec_Cache_Init(true);
+#endif
+	}
+
+	void TearDown() override
+	{
+		if (block != 0)
+			DOS_FreeMemory(block);
+	}
+
+	// Run the kernel on the core for the given cycles. Returns host seconds, or -1
+	// if the core stopped early or left the kernel.
+	double Run(const Kernel& kernel, size_t core, cpu_cycles_count_t cycles)
+	{
+		Code code((uint16_t)(CODE_OFFSET + core * 0x1000), seg);
+		kernel.build(code);
+		for (size_t i = 0; i < code.bytes.size(); i++)
+			real_writeb(seg, (uint16_t)(code.org + i), code.bytes[i]);
+
+		FillFlags();
+		const CPU_Regs saved_regs = cpu_regs;
+		const uint16_t saved_cs = SegValue(cs), saved_ds = SegValue(ds), saved_es = SegValue(es);
+		const Bitu saved_cr0 = cpu.cr0, saved_cr3 = paging.cr3;
+		const Bitu saved_gdt_limit = CPU_SGDT_limit(), saved_gdt_base = CPU_SGDT_base();
+		const unsigned char saved_autodetermine = CPU_AutoDetermineMode;
+		const cpu_cycles_count_t saved_cycles = CPU_Cycles, saved_left = CPU_CycleLeft;
+		CPU_Decoder* saved_decoder = cpudecoder;
+
+		// nothing else runs meanwhile: no interrupts, and no switching cores or cycles on
+		// entering protected mode
+		CPU_AutoDetermineMode = 0;
+		SETFLAGBIT(IF, false);
+		CPU_SetSegGeneral(cs, seg);
+		CPU_SetSegGeneral(ds, seg);
+		CPU_SetSegGeneral(es, seg);
+		reg_eip = code.org;
+		CPU_Cycles = cycles;
+		CPU_CycleLeft = 0;
+
+		// a core that has to stop early, e.g. after writing CR0, leaves the rest of its
+		// cycles in CPU_CycleLeft for the next run, like the main loop expects
+		Bits ret = 0;
+		const auto start = std::chrono::steady_clock::now();
+		while (ret == 0) {
+			if (CPU_Cycles <= 0) {
+				if (CPU_CycleLeft <= 0) break;
+				CPU_Cycles = CPU_CycleLeft;
+				CPU_CycleLeft = 0;
+			}
+			ret = cores[core].run();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		const bool completed = ret == 0 && CPU_Cycles <= 0 && SegPhys(cs) == (PhysPt)seg * 16u &&
+			reg_eip >= code.org && reg_eip < code.Here();
+
+		if (cpu.cr0 != saved_cr0) CPU_SET_CRX(0, saved_cr0);
+		if (paging.cr3 != saved_cr3) CPU_SET_CRX(3, saved_cr3);
+		CPU_LGDT(saved_gdt_limit, saved_gdt_base);
+		PAGING_ClearTLB();
+		cpu_regs = saved_regs;
+		CPU_SetSegGeneral(cs, saved_cs);
+		CPU_SetSegGeneral(ds, saved_ds);
+		CPU_SetSegGeneral(es, saved_es);
+		CPU_AutoDetermineMode = saved_autodetermine;
+		CPU_Cycles = saved_cycles;
+		CPU_CycleLeft = saved_left;
+		cpudecoder = saved_decoder;
+
+		return completed ? seconds : -1;
+	}
+
+	// Protected mode kernels need the DOS session to be in real mode, not virtual 8086 mode
+	static bool Runnable(const Kernel& kernel)
+	{
+		return !kernel.mode_switch || !cpu.pmode;
+	}
+
+	uint16_t block = 0, seg = 0;
+};
+
+TEST_F(CPUCoreTest, EveryKernelRunsOnEveryCore)
+{
+	for (const Kernel& kernel : kernels) {
+		if (!Runnable(kernel))
+			continue;
+		for (size_t core = 0; core < sizeof(cores) / sizeof(cores[0]); core++)
+			EXPECT_GE(Run(kernel, core, 20000), 0.0) << kernel.name << " on the " << cores[core].name << " core";
+	}
+}
+
+// One line per kernel and core: "core-bench <kernel> <core> <M cycles per host second>"
+TEST_F(CPUCoreTest, Benchmark_Kernels)
+{
+	const cpu_cycles_count_t cycles = 2000000;
+
+	for (const Kernel& kernel : kernels) {
+		if (!Runnable(kernel)) {
+			printf("core-bench %-12s skipped, needs real mode\n", kernel.name);
+			continue;
+		}
+		for (size_t core = 0; core < sizeof(cores) / sizeof(cores[0]); core++) {
+			Run(kernel, core, cycles / 10); // warm up the dynamic cores' caches
+
+			const double seconds = Run(kernel, core, cycles);
+			ASSERT_GE(seconds, 0.0) << kernel.name << " on the " << cores[core].name << " core";
+			printf("core-bench %-12s %-8s %9.2f\n", kernel.name, cores[core].name, cycles / (seconds + 1e-9) / 1e6);
+		}
+	}
+}
+
+} // namespace
@@ -0,0 +1,182 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "cpu.h"
+#include "dos_inc.h"
+#include "mem.h"
+#include "regs.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+bool ParseCommand(char* str);
+int32_t DEBUG_Run(int32_t amount,bool quickexit);
+
+namespace {
+
+#if C_HEAVY_DEBUG
+
+class DebugBreakpointTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		uint16_t blocks = 0x100; // 4KB: loop at 0, watched bytes at 100h, breakpoints at 800h
+		ASSERT_TRUE(DOS_AllocateMemory(&seg, &blocks));
+
+		// mov ecx,iterations / dec ecx / jnz $-2 / jmp $
+		static const uint8_t loop[] = { 0x66, 0xB9, 0, 0, 0, 0, 0x66, 0x49, 0x75, 0xFC, 0xEB, 0xFE };
+		// mov byte [cs:105h],55h / jmp $
+		static const uint8_t store[] = { 0x2E, 0xC6, 0x06, 0x05, 0x01, 0x55, 0xEB, 0xFE };
+		for (unsigned int i = 0; i < sizeof(loop); i++)
+			real_writeb(seg, i, loop[i]);
+		for (unsigned int i = 0; i < sizeof(store); i++)
+			real_writeb(seg, 0x10 + i, store[i]);
+		for (unsigned int i = 0; i < 0x100; i++)
+			real_writeb(seg, 0x100 + i, 0); // a new memory breakpoint starts out expecting 0
+	}
+
+	void TearDown() override
+	{
+		Command("BPDEL *");
+		if (seg != 0)
+			DOS_FreeMemory(seg);
+	}
+
+	static void Command(const std::string &cmd)
+	{
+		std::string copy = cmd;
+		ParseCommand(&copy[0]);
+	}
+
+	// execution breakpoints inside the block that are never reached, or memory
+	// breakpoints on bytes the loop does not write
+	void SetBreakpoints(bool memory, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++) {
+			char cmd[32];
+			if (memory) sprintf(cmd, "BPM %X:%X", seg, 0x100 + i);
+			else sprintf(cmd, "BP %X:%X", seg, 0x800 + i * 3);
+			Command(cmd);
+		}
+
+		// new breakpoints are activated when the debugger resumes
+		DEBUG_Run(0, false);
+	}
+
+	// Execute instructions at seg:ip on the normal core, which checks breakpoints before
+	// every instruction. Returns false if a breakpoint stopped it early.
+	bool Execute(uint16_t ip, cpu_cycles_count_t instructions)
+	{
+		CPU_SetSegGeneral(cs, seg);
+		reg_eip = ip;
+		CPU_Cycles = instructions;
+		CPU_Core_Normal_Run();
+		return CPU_Cycles <= 0;
+	}
+
+	// Run the loop, returns emulated instructions per second or 0 if it did not run to the end
+	double Run(uint32_t iterations)
+	{
+		const uint16_t old_cs = SegValue(cs);
+		const uint32_t old_eip = reg_eip, old_ecx = reg_ecx;
+		const cpu_cycles_count_t old_cycles = CPU_Cycles;
+
+		real_writed(seg, 2, iterations);
+		const cpu_cycles_count_t instructions = 1 + 2 * (cpu_cycles_count_t)iterations;
+		const auto start = std::chrono::steady_clock::now();
+		const bool completed = Execute(0, instructions) && reg_ecx == 0 && reg_eip == 10;
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		CPU_Cycles = old_cycles;
+		CPU_SetSegGeneral(cs, old_cs);
+		reg_eip = old_eip;
+		reg_ecx = old_ecx;
+
+		return completed ? (double)instructions / (seconds + 1e-9) : 0;
+	}
+
+	// Run the store to seg:105h and one more instruction, returns true if it was not stopped
+	bool RunStore()
+	{
+		const uint16_t old_cs = SegValue(cs);
+		const uint32_t old_eip = reg_eip;
+		const cpu_cycles_count_t old_cycles = CPU_Cycles;
+
+		const bool completed = Execute(0x10, 3);
+
+		CPU_Cycles = old_cycles;
+		CPU_SetSegGeneral(cs, old_cs);
+		reg_eip = old_eip;
+		return completed;
+	}
+
+	uint16_t seg = 0;
+};
+
+TEST_F(DebugBreakpointTest, StopsOnlyWhenHit)
+{
+	SetBreakpoints(false, 10);
+	SetBreakpoints(true, 10);
+	EXPECT_GT(Run(1000), 0.0);
+
+	// so does a change to a watched byte, once, whether made by the emulator
+	real_writeb(seg, 0x105, 0x55);
+	EXPECT_EQ(Run(1000), 0.0);
+	EXPECT_GT(Run(1000), 0.0);
+
+	// or by the CPU, right after the instruction that wrote it
+	real_writeb(seg, 0x105, 0);
+	EXPECT_EQ(Run(1000), 0.0);
+	EXPECT_FALSE(RunStore());
+	EXPECT_EQ(real_readb(seg, 0x105), 0x55);
+	EXPECT_GT(Run(1000), 0.0);
+
+	// a breakpoint inside the loop stops it
+	char cmd[32];
+	sprintf(cmd, "BP %X:6", seg);
+	Command(cmd);
+	DEBUG_Run(0, false);
+	EXPECT_EQ(Run(1000), 0.0);
+}
+
+TEST_F(DebugBreakpointTest, Benchmark_InstructionsPerSecond)
+{
+	static const unsigned int counts[3] = { 0, 10, 100 };
+
+	for (unsigned int kind = 0; kind < 2; kind++) {
+		for (unsigned int c = 0; c < 3; c++) {
+			Command("BPDEL *");
+			SetBreakpoints(kind == 1, counts[c]);
+
+			const double ips = Run(5000000);
+			ASSERT_GT(ips, 0.0) << "a breakpoint stopped the loop";
+			printf("heavy debug, %3u %-10s breakpoints: %8.2f M instructions/s\n", counts[c],
+			       kind ? "memory" : "execution", ips / 1e6);
+		}
+	}
+}
+
+#endif // C_HEAVY_DEBUG
+
+} // namespace
@@ -0,0 +1,156 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "cpu.h"
+#include "dos_inc.h"
+#include "mem.h"
+#include "regs.h"
+
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+bool ParseCommand(char* str);
+void DEBUG_StopLog(void);
+void DEBUG_HeavyWriteLogInstruction(void);
+
+namespace {
+
+#if C_HEAVY_DEBUG
+
+class DebugCPUTraceTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		uint16_t blocks = 0x100;
+		ASSERT_TRUE(DOS_AllocateMemory(&seg, &blocks));
+
+		static const uint8_t code[] = {
+			0xBB, 0x34, 0x12,		// mov bx,1234h
+			0x2E, 0x01, 0x1E, 0x00, 0x02,	// add [cs:200h],bx
+			0x2E, 0xA1, 0x00, 0x02,		// mov ax,[cs:200h]
+			0x66, 0xB9, 0, 0, 0, 0,		// mov ecx,iterations
+			0x66, 0x49, 0x75, 0xFC,		// dec ecx / jnz $-2
+			0xEB, 0xFE			// jmp $
+		};
+		for (unsigned int i = 0; i < sizeof(code); i++)
+			real_writeb(seg, i, code[i]);
+		real_writew(seg, 0x200, 0x1111);
+	}
+
+	void TearDown() override
+	{
+		if (seg != 0)
+			DOS_FreeMemory(seg);
+	}
+
+	static void Command(const std::string &cmd)
+	{
+		std::string copy = cmd;
+		ParseCommand(&copy[0]);
+	}
+
+	// run the code from the start on the normal core, returns instructions per second
+	double Run(uint32_t iterations)
+	{
+		const uint16_t old_cs = SegValue(cs);
+		const uint32_t old_eip = reg_eip, old_ebx = reg_ebx, old_ecx = reg_ecx, old_eax = reg_eax;
+		const cpu_cycles_count_t old_cycles = CPU_Cycles;
+
+		real_writed(seg, 14, iterations);
+		const cpu_cycles_count_t instructions = 4 + 2 * (cpu_cycles_count_t)iterations;
+		CPU_SetSegGeneral(cs, seg);
+		reg_eip = 0;
+		CPU_Cycles = instructions;
+		const auto start = std::chrono::steady_clock::now();
+		CPU_Core_Normal_Run();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		CPU_Cycles = old_cycles;
+		CPU_SetSegGeneral(cs, old_cs);
+		reg_eip = old_eip;
+		reg_eax = old_eax;
+		reg_ebx = old_ebx;
+		reg_ecx = old_ecx;
+		return (double)instructions / (seconds + 1e-9);
+	}
+
+	static std::vector<std::string> ReadLines(const char* name)
+	{
+		std::vector<std::string> lines;
+		std::ifstream in(name);
+		std::string line;
+		while (std::getline(in, line))
+			lines.push_back(line);
+		return lines;
+	}
+
+	uint16_t seg = 0;
+};
+
+TEST_F(DebugCPUTraceTest, LogShowsOperandsAsTheyWere)
+{
+	Command("LOG 100");
+	Run(2);
+	DEBUG_StopLog();
+
+	const std::vector<std::string> lines = ReadLines("LOGCPU.TXT");
+	remove("LOGCPU.TXT");
+	ASSERT_GE(lines.size(), 4u);
+
+	char prefix[16];
+	sprintf(prefix, "%04X:00000003", seg);
+	EXPECT_EQ(lines[1].compare(0, strlen(prefix), prefix), 0) << lines[1];
+	EXPECT_NE(lines[1].find("add  cs:[0200],bx"), std::string::npos) << lines[1];
+	EXPECT_NE(lines[1].find("cs:[0200]=1111"), std::string::npos) << lines[1];
+	EXPECT_NE(lines[1].find("EBX:00001234"), std::string::npos) << lines[1];
+	EXPECT_NE(lines[2].find("cs:[0200]=2345"), std::string::npos) << lines[2];
+
+	// the ring of the heavy log decodes the same way
+	Command("HEAVYLOG");
+	real_writew(seg, 0x200, 0x1111);
+	Run(2);
+	DEBUG_HeavyWriteLogInstruction();
+
+	const std::vector<std::string> heavy = ReadLines("LOGCPU_INT_CD.TXT");
+	remove("LOGCPU_INT_CD.TXT");
+	ASSERT_EQ(heavy.size(), 4u + 2u * 2u);
+	EXPECT_EQ(heavy[1].substr(0, 90), lines[1].substr(0, 90));
+	EXPECT_EQ(heavy[2].substr(0, 90), lines[2].substr(0, 90));
+}
+
+TEST_F(DebugCPUTraceTest, Benchmark_HeavyLog)
+{
+	const double plain = Run(2000000);
+	Command("HEAVYLOG");
+	const double logged = Run(2000000);
+	Command("HEAVYLOG");
+	printf("heavy debug: %8.2f M instructions/s, with HEAVYLOG %8.2f M instructions/s\n",
+	       plain / 1e6, logged / 1e6);
+}
+
+#endif // C_HEAVY_DEBUG
+
+} // namespace
@@ -0,0 +1,102 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dos_inc.h"
+#include "../src/ints/int10.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+extern int log_dev_con;
+extern std::string log_dev_con_str;
+extern Bitu dev_con_run_chars;
+
+namespace {
+
+class DeviceCONTest : public DOSBoxTestFixture {};
+
+struct ConScreen {
+	std::vector<uint8_t> cells;
+	uint8_t row = 0, col = 0;
+};
+
+// Clear the screen, write text to CON through DOS and capture what ends up in video memory
+ConScreen WriteToCON(const std::string &text)
+{
+	const uint8_t page = real_readb(BIOSMEM_SEG, BIOSMEM_CURRENT_PAGE);
+	BIOS_NCOLS;
+	BIOS_NROWS;
+
+	INT10_ScrollWindow(0, 0, 255, 255, 0, 0x07, page);
+	INT10_SetCursorPos(0, 0, page);
+
+	uint16_t amount = (uint16_t)text.size();
+	DOS_WriteFile(STDOUT, (const uint8_t *)text.data(), &amount);
+
+	ConScreen screen;
+	const PhysPt base = CurMode->pstart + page * real_readw(BIOSMEM_SEG, BIOSMEM_PAGE_SIZE);
+	for (Bitu i = 0; i < (Bitu)ncols * nrows * 2u; i++)
+		screen.cells.push_back(mem_readb(base + i));
+	screen.row = CURSOR_POS_ROW(page);
+	screen.col = CURSOR_POS_COL(page);
+	return screen;
+}
+
+// Logging CON output forces the per-character path, which is what the run based path must reproduce
+TEST_F(DeviceCONTest, OutputRunMatchesPerCharacterOutput)
+{
+	if (CurMode->type != M_TEXT)
+		GTEST_SKIP() << "needs a text mode";
+
+	std::string text = "\033[1;33m";
+	for (int line = 0; line < 40; line++) {
+		for (int i = 0; i < 30 + (line * 7) % 150; i++)
+			text += (char)('A' + (line + i) % 26);
+		text += (line % 3) ? "\r\n" : "\t|\x01\x7f\n\r";
+	}
+	text += "\033[0mtrailing text without newline";
+
+	const int saved_log = log_dev_con;
+
+	log_dev_con = 1;
+	const Bitu before_per_char = dev_con_run_chars;
+	const ConScreen per_char = WriteToCON(text);
+	const Bitu per_char_run_chars = dev_con_run_chars - before_per_char;
+	log_dev_con_str.clear();
+
+	log_dev_con = 0;
+	const Bitu before_run = dev_con_run_chars;
+	const ConScreen run = WriteToCON(text);
+	const Bitu run_chars = dev_con_run_chars - before_run;
+
+	log_dev_con = saved_log;
+
+	// the first pass must not touch the run path, the second must handle nearly all of the text
+	ASSERT_EQ(per_char_run_chars, 0u);
+	ASSERT_GE(run_chars, text.size() / 2) << "run path not taken";
+
+	EXPECT_EQ(per_char.row, run.row);
+	EXPECT_EQ(per_char.col, run.col);
+	EXPECT_TRUE(per_char.cells == run.cells);
+}
+
+} // namespace
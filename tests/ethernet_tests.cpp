@@ -0,0 +1,194 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "ethernet.h"
+
+#include <chrono>
+#include <deque>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+namespace {
+
+// Sends every packet straight back, like a host that echoes everything. Each poll
+// costs about as much as the poll() system call the slirp backend makes.
+class LoopbackEthernetConnection : public EthernetConnection {
+public:
+	LoopbackEthernetConnection(unsigned int poll_us) : poll_us(poll_us) {}
+
+	bool Initialize(Section* config) override
+	{
+		(void)config;
+		return true;
+	}
+
+	void SendPacket(const uint8_t* packet, int len) override
+	{
+		last_thread = std::this_thread::get_id();
+		pending.push_back(std::vector<uint8_t>(packet, packet + len));
+	}
+
+	void GetPackets(std::function<void(const uint8_t*, int)> callback) override
+	{
+		const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(poll_us);
+		while (poll_us != 0 && std::chrono::steady_clock::now() < end);
+
+		while (!pending.empty()) {
+			callback(pending.front().data(), (int)pending.front().size());
+			pending.pop_front();
+		}
+	}
+
+	unsigned int poll_us;
+	std::deque<std::vector<uint8_t>> pending;
+	std::thread::id last_thread;
+};
+
+class EthernetThreadTest : public DOSBoxTestFixture {
+public:
+	static void MakeFrame(uint8_t* frame, int len, uint32_t seq)
+	{
+		memset(frame, 0, (size_t)len);
+		memcpy(frame + 14, &seq, sizeof(seq));
+	}
+
+	static uint32_t FrameSeq(const uint8_t* frame)
+	{
+		uint32_t seq;
+		memcpy(&seq, frame + 14, sizeof(seq));
+		return seq;
+	}
+
+	// Send count frames, at most window of them outstanding, the way the NE2000 transmits
+	// between polls. Returns the number of frames received back in order.
+	static uint32_t Echo(EthernetConnection* conn, uint32_t count, uint32_t window, int len)
+	{
+		uint8_t frame[1514];
+		uint32_t sent = 0, received = 0;
+		bool in_order = true;
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+		while (received < count && std::chrono::steady_clock::now() < deadline) {
+			while (sent < count && sent - received < window) {
+				MakeFrame(frame, len, sent++);
+				conn->SendPacket(frame, len);
+			}
+			conn->GetPackets([&](const uint8_t* packet, int plen) {
+				if (plen != len || FrameSeq(packet) != received) in_order = false;
+				received++;
+			});
+		}
+		return in_order ? received : 0;
+	}
+};
+
+TEST_F(EthernetThreadTest, EchoesFramesInOrderFromTheNetworkThread)
+{
+	LoopbackEthernetConnection* backend = new LoopbackEthernetConnection(0);
+	EthernetConnection* conn = OpenEthernetThread(backend);
+	ASSERT_NE(conn, (EthernetConnection*)backend);
+
+	EXPECT_EQ(Echo(conn, 10000, 64, 1514), 10000u);
+	EXPECT_EQ(Echo(conn, 1000, 1, 60), 1000u);
+	EXPECT_NE(backend->last_thread, std::this_thread::get_id());
+
+	delete conn; // closes the backend too
+}
+
+TEST_F(EthernetThreadTest, DropsWhenTheQueueIsFull)
+{
+	EthernetConnection* conn = OpenEthernetThread(new LoopbackEthernetConnection(0));
+
+	// nobody drains the received packets, so all but a queue's worth are dropped
+	uint8_t frame[64];
+	for (uint32_t i = 0; i < 4096; i++) {
+		MakeFrame(frame, sizeof(frame), i);
+		conn->SendPacket(frame, sizeof(frame));
+		if ((i & 63) == 63) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	uint32_t received = 0, expect = 0;
+	bool in_order = true;
+	conn->GetPackets([&](const uint8_t* packet, int len) {
+		if (len != (int)sizeof(frame) || FrameSeq(packet) != expect) in_order = false;
+		expect++;
+		received++;
+	});
+	EXPECT_GT(received, 0u);
+	EXPECT_LT(received, 4096u);
+	EXPECT_TRUE(in_order);
+
+	// and it keeps working afterwards
+	EXPECT_EQ(Echo(conn, 100, 8, 100), 100u);
+	delete conn;
+}
+
+// The emulator polls the connection once per millisecond from its timer tick handler.
+// Time spent in the connection stalls emulation, the frames sent in one tick are
+// received in the same tick or a later one.
+TEST_F(EthernetThreadTest, Benchmark_Loopback)
+{
+	const unsigned int ticks = 500, frames_per_tick = 8;
+
+	for (unsigned int threaded = 0; threaded < 2; threaded++) {
+		EthernetConnection* conn = new LoopbackEthernetConnection(20);
+		if (threaded) conn = OpenEthernetThread(conn);
+
+		std::vector<std::chrono::steady_clock::time_point> sent_at;
+		double stall = 0, latency = 0;
+		uint32_t received = 0;
+		uint8_t frame[1514];
+
+		const auto start = std::chrono::steady_clock::now();
+		auto next = start;
+		for (unsigned int tick = 0; tick < ticks + 10; tick++) {
+			next += std::chrono::milliseconds(1);
+
+			const auto t0 = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < frames_per_tick && tick < ticks; i++) {
+				MakeFrame(frame, sizeof(frame), (uint32_t)sent_at.size());
+				conn->SendPacket(frame, sizeof(frame));
+				sent_at.push_back(std::chrono::steady_clock::now());
+			}
+			conn->GetPackets([&](const uint8_t* packet, int len) {
+				(void)len;
+				latency += std::chrono::duration<double>(std::chrono::steady_clock::now() - sent_at[FrameSeq(packet)]).count();
+				received++;
+			});
+			stall += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+			std::this_thread::sleep_until(next);
+		}
+
+		ASSERT_EQ(received, (uint32_t)sent_at.size());
+		printf("%-6s: %7.0f frames/s, %6.2fus per tick in the emulation thread, %7.1fus from send to receive\n",
+		       threaded ? "thread" : "direct", received / std::chrono::duration<double>(next - start).count(),
+		       stall * 1e6 / (ticks + 10), latency * 1e6 / received);
+		delete conn;
+	}
+}
+
+} // namespace
@@ -0,0 +1,221 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "dosbox.h"
+#include "control.h"
+#include "inout.h"
+#include "setup.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+void GUS_OnReset(Section* sec);
+void GUS_ShutDown(Section* sec);
+void GUS_RenderVoices(int32_t* stream, Bitu len, bool per_sample);
+
+namespace {
+
+class GUS_RenderTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		section = static_cast<Section_prop *>(control->GetSection("gus"));
+		ASSERT_NE(section, nullptr);
+		if (!section->Get_bool("gus")) {
+			// the card is created at reset, and does nothing if it was disabled then
+			ASSERT_TRUE(section->HandleInputline("gus=true"));
+			GUS_ShutDown(section);
+			GUS_OnReset(section);
+			enabled = true;
+		}
+		base = (uint16_t)(section->Get_hex("gusbase") - 0x200u);
+
+		// the card answers DRAM peeks and pokes
+		WriteReg16(0x43, 0x1234);
+		WriteReg8(0x44, 0x00);
+		IO_WriteB(base + 0x307, 0xA5);
+		if (IO_ReadB(base + 0x307) != 0xA5)
+			GTEST_SKIP() << "no Gravis Ultrasound emulation";
+
+		WriteReg8(0x4C, 0x01); // out of reset, then DAC enable
+		WriteReg8(0x4C, 0x03);
+		WriteReg8(0x0E, 31);   // 32 voices
+	}
+
+	void TearDown() override
+	{
+		if (!enabled)
+			return;
+		GUS_ShutDown(section);
+		section->HandleInputline("gus=false");
+		GUS_OnReset(section);
+	}
+
+	void WriteReg8(uint8_t reg, uint8_t val)
+	{
+		IO_WriteB(base + 0x303, reg);
+		IO_WriteB(base + 0x305, val);
+	}
+
+	void WriteReg16(uint8_t reg, uint16_t val)
+	{
+		IO_WriteB(base + 0x303, reg);
+		IO_WriteW(base + 0x304, val);
+	}
+
+	uint16_t ReadReg16(uint8_t reg)
+	{
+		IO_WriteB(base + 0x303, reg);
+		return (uint16_t)IO_ReadW(base + 0x304);
+	}
+
+	// address registers hold the 20-bit sample position and 9 fraction bits
+	void WriteAddr(uint8_t reg, uint32_t addr)
+	{
+		WriteReg16(reg, (uint16_t)(addr >> 16));
+		WriteReg16(reg + 1, (uint16_t)addr);
+	}
+
+	void FillRam(uint32_t bytes)
+	{
+		uint32_t x = 12345;
+		for (uint32_t a = 0; a < bytes; a++) {
+			x = x * 1103515245u + 12345u;
+			WriteReg16(0x43, (uint16_t)a);
+			WriteReg8(0x44, (uint8_t)(a >> 16));
+			IO_WriteB(base + 0x307, (uint8_t)(x >> 16));
+		}
+	}
+
+	// Give every voice its own mix of 8/16-bit, looping, bidirectional, rollover, IRQs,
+	// volume ramps and panning. The same seed gives the same voices.
+	void ProgramVoices(uint32_t seed)
+	{
+		for (uint8_t v = 0; v < 32; v++) {
+			IO_WriteB(base + 0x302, v);
+			WriteReg8(0x00, 0x03);
+			WriteReg8(0x0D, 0x03);
+		}
+
+		uint32_t x = seed;
+		auto next = [&x](uint32_t range) {
+			x = x * 1103515245u + 12345u;
+			return (x >> 8) % range;
+		};
+
+		for (uint8_t v = 0; v < 32; v++) {
+			IO_WriteB(base + 0x302, v);
+
+			const uint32_t start = (next(0x8000) << 9) + next(512);
+			const uint32_t end = start + ((64 + next(4000)) << 9);
+			const uint32_t pos = start + next(end - start);
+			WriteAddr(0x02, start);
+			WriteAddr(0x04, end);
+			WriteAddr(0x0A, pos);
+			WriteReg16(0x01, (uint16_t)(next(0x8000) << 1));
+
+			WriteReg8(0x06, (uint8_t)next(256));        // ramp rate
+			WriteReg8(0x07, (uint8_t)(0x40 + next(0x40)));
+			WriteReg8(0x08, (uint8_t)(0xC0 + next(0x40)));
+			WriteReg16(0x09, (uint16_t)((0x400 + next(0xB00)) << 4));
+			WriteReg8(0x0C, (uint8_t)next(16));
+
+			// ramp control: stopped, looping, bidirectional, decreasing, IRQ, rollover
+			WriteReg8(0x0D, (uint8_t)(next(4) == 0 ? 0x03 : (next(0x80) & 0x7C)));
+			// wave control: running or stopped, 16-bit, looping, bidirectional, IRQ, decreasing
+			WriteReg8(0x00, (uint8_t)(next(5) == 0 ? 0x01 : (next(0x80) & 0x7C)));
+		}
+	}
+
+	struct VoiceState {
+		uint16_t ctrl, addr_hi, addr_lo, volume, ramp_ctrl;
+		bool operator==(const VoiceState &o) const
+		{
+			return ctrl == o.ctrl && addr_hi == o.addr_hi && addr_lo == o.addr_lo &&
+			       volume == o.volume && ramp_ctrl == o.ramp_ctrl;
+		}
+	};
+
+	std::vector<VoiceState> Voices()
+	{
+		std::vector<VoiceState> state;
+		for (uint8_t v = 0; v < 32; v++) {
+			IO_WriteB(base + 0x302, v);
+			// reading the voice control registers shows the voice's IRQ pending bit
+			state.push_back({ ReadReg16(0x80), ReadReg16(0x8A), ReadReg16(0x8B), ReadReg16(0x89),
+			                  ReadReg16(0x8D) });
+		}
+		return state;
+	}
+
+	Section_prop* section = nullptr;
+	bool enabled = false;
+	uint16_t base = 0x40;
+};
+
+TEST_F(GUS_RenderTest, BlockRendererMatchesPerSample)
+{
+	FillRam(0x40000);
+
+	for (uint32_t seed = 1; seed <= 8; seed++) {
+		std::vector<int32_t> out[2];
+		std::vector<VoiceState> voices[2];
+		for (unsigned int per_sample = 0; per_sample < 2; per_sample++) {
+			ProgramVoices(seed);
+			// odd lengths leave the SIMD loops a remainder
+			for (unsigned int call = 0; call < 40; call++) {
+				std::vector<int32_t> buf((size_t)(2 * (61 + call * 7)), 0);
+				GUS_RenderVoices(buf.data(), buf.size() / 2, per_sample != 0);
+				out[per_sample].insert(out[per_sample].end(), buf.begin(), buf.end());
+			}
+			voices[per_sample] = Voices();
+		}
+
+		ASSERT_EQ(out[0].size(), out[1].size());
+		for (size_t i = 0; i < out[0].size(); i++)
+			ASSERT_EQ(out[0][i], out[1][i]) << "seed " << seed << " sample " << i / 2;
+		for (unsigned int v = 0; v < 32; v++)
+			EXPECT_TRUE(voices[0][v] == voices[1][v]) << "seed " << seed << " voice " << v;
+	}
+}
+
+TEST_F(GUS_RenderTest, Benchmark_Voices)
+{
+	FillRam(0x40000);
+
+	for (unsigned int per_sample = 0; per_sample < 2; per_sample++) {
+		ProgramVoices(3);
+		std::vector<int32_t> buf(2 * 1024);
+		const unsigned int calls = 2000;
+		const auto start = std::chrono::steady_clock::now();
+		for (unsigned int call = 0; call < calls; call++)
+			GUS_RenderVoices(buf.data(), buf.size() / 2, per_sample != 0);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		printf("gus render %-10s: %8.2f M voice samples/s\n", per_sample ? "per-sample" : "block",
+		       32.0 * calls * (buf.size() / 2) / seconds / 1e6);
+	}
+}
+
+} // namespace
@@ -0,0 +1,394 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "bios_disk.h"
+#include "callback.h"
+#include "control.h"
+#include "ide.h"
+#include "inout.h"
+#include "mem.h"
+#include "pci_bus.h"
+#include "pic.h"
+#include "setup.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+int MSCDEX_AddDrive(char driveLetter, const char* physicalPath, uint8_t& subUnit);
+int MSCDEX_RemoveDrive(char driveLetter);
+
+namespace {
+
+// primary channel task file
+const Bitu ATA_DATA    = 0x1F0;
+const Bitu ATA_FEATURE = 0x1F1;
+const Bitu ATA_COUNT   = 0x1F2;
+const Bitu ATA_LBA0    = 0x1F3;
+const Bitu ATA_LBA1    = 0x1F4;
+const Bitu ATA_LBA2    = 0x1F5;
+const Bitu ATA_DRIVE   = 0x1F6;
+const Bitu ATA_CMD     = 0x1F7;
+
+const uint8_t ATA_ST_BSY = 0x80;
+const uint8_t ATA_ST_DRQ = 0x08;
+const uint8_t ATA_ST_ERR = 0x01;
+
+// SFF-8038i bus master registers, relative to BAR4
+const uint8_t BM_CMD_START = 0x01;
+const uint8_t BM_CMD_WRITE = 0x08; // bus master writes to memory (device read)
+const uint8_t BM_ST_ACTIVE = 0x01;
+const uint8_t BM_ST_ERROR  = 0x02;
+const uint8_t BM_ST_IRQ    = 0x04;
+
+// guest physical layout. bit 20 stays clear so the A20 gate does not matter.
+// the first region straddles the 4KB page boundary at 0x201000.
+const PhysPt PRD_TABLE   = 0x200000;
+const PhysPt REGION0     = 0x200C00;
+const PhysPt REGION1     = 0x203000;
+const PhysPt SCRATCH_END = 0x204000;
+
+const uint32_t DISK_CYLS    = 20;
+const uint32_t DISK_HEADS   = 4;
+const uint32_t DISK_SECTORS = 32;
+const unsigned SECTORS      = 8; // 4KB per transfer, 2KB per PRD region
+
+unsigned ide_irq_count = 0;
+
+Bitu IDE_Test_IRQ14(void)
+{
+	// reading the status register acknowledges the device interrupt
+	IO_ReadB(ATA_CMD);
+	ide_irq_count++;
+	return CBRET_NONE;
+}
+
+uint8_t DiskPattern(Bitu lba, Bitu ofs)
+{
+	return (uint8_t)((lba * 7u) + ofs + (ofs >> 8u));
+}
+
+class IDEBusMasterTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		if (!pcibus_enable)
+			GTEST_SKIP() << "PCI bus disabled";
+		if (IDE_controller_occupied(0, false) || IDE_controller_occupied(0, true))
+			GTEST_SKIP() << "primary IDE channel already in use";
+
+		primary = static_cast<Section_prop *>(control->GetSection("ide, primary"));
+		secondary = static_cast<Section_prop *>(control->GetSection("ide, secondary"));
+		ASSERT_NE(primary, nullptr);
+		if (!primary->Get_bool("enable"))
+			GTEST_SKIP() << "primary IDE channel disabled";
+
+		saved_busmaster = primary->Get_bool("bus master dma");
+		ASSERT_TRUE(primary->HandleInputline("bus master dma=true"));
+		ide_inits[0](primary);
+		reinitialized = true;
+
+		bm_base = FindBusMaster();
+		ASSERT_NE(bm_base, 0u) << "no PCI bus master IDE function";
+
+		for (PhysPt a = PRD_TABLE; a < SCRATCH_END; a++)
+			saved_ram.push_back(phys_readb(a));
+
+		irq.Install(&IDE_Test_IRQ14, CB_IRET_EOI_PIC2, "IDE bus master test");
+		irq.Set_RealVec(0x76);
+		ide_irq_count = 0;
+	}
+
+	void TearDown() override
+	{
+		if (!reinitialized)
+			return;
+
+		irq.Uninstall();
+		for (size_t i = 0; i < saved_ram.size(); i++)
+			phys_writeb(PRD_TABLE + (PhysPt)i, saved_ram[i]);
+
+		if (disk_index >= 0) {
+			IDE_Hard_Disk_Detach((unsigned char)disk_index);
+			imageDiskList[disk_index] = NULL;
+			disk->Release();
+		}
+		if (cd_letter != 0) {
+			IDE_CDROM_Detach((unsigned char)(cd_letter - 'A'));
+			MSCDEX_RemoveDrive(cd_letter);
+		}
+
+		primary->HandleInputline(saved_busmaster ? "bus master dma=true" : "bus master dma=false");
+		ide_inits[0](primary);
+		if (!saved_busmaster && !(secondary != nullptr && secondary->Get_bool("bus master dma")))
+			PCI_RemoveIDEBusMaster_Device();
+	}
+
+	// walk PCI bus 0 through configuration mechanism #1 looking for the PIIX3 IDE function
+	static unsigned FindBusMaster()
+	{
+		for (unsigned slot = 0; slot < 32; slot++) {
+			IO_WriteD(0xCF8, 0x80000000u | (slot << 11u));
+			if (IO_ReadD(0xCFC) != 0x70108086u)
+				continue;
+			IO_WriteD(0xCF8, 0x80000000u | (slot << 11u) | 0x20u);
+			return (unsigned)(IO_ReadD(0xCFC) & 0xFFF0u);
+		}
+		return 0;
+	}
+
+	// run the emulated machine (with interrupts) until cond() holds or ms of emulated time pass
+	template <typename F>
+	static bool RunUntil(F cond, double ms = 50.0)
+	{
+		const double end = PIC_FullIndex() + ms;
+		while (!cond() && PIC_FullIndex() < end)
+			CALLBACK_Idle();
+		return cond();
+	}
+
+	static bool NotBusy()
+	{
+		return (IO_ReadB(0x3F6) & ATA_ST_BSY) == 0; // alternate status, no IRQ ack
+	}
+
+	void AttachDisk()
+	{
+		for (int i = 2; i < MAX_DISK_IMAGES; i++) {
+			if (imageDiskList[i] == NULL) {
+				disk_index = i;
+				break;
+			}
+		}
+		ASSERT_GE(disk_index, 0) << "no free BIOS disk slot";
+
+		FILE *f = tmpfile();
+		ASSERT_NE(f, nullptr);
+		const Bitu total = (Bitu)DISK_CYLS * DISK_HEADS * DISK_SECTORS;
+		std::vector<uint8_t> sector(512);
+		for (Bitu lba = 0; lba < total; lba++) {
+			for (Bitu i = 0; i < 512; i++)
+				sector[i] = DiskPattern(lba, i);
+			fwrite(&sector[0], 512, 1, f);
+		}
+		fflush(f);
+
+		disk = new imageDisk(f, "idebm.img", DISK_CYLS, DISK_HEADS, DISK_SECTORS, 512, true);
+		disk->Addref();
+		imageDiskList[disk_index] = disk;
+		IDE_Hard_Disk_Attach(0, false, (unsigned char)disk_index);
+		ASSERT_TRUE(IDE_controller_occupied(0, false));
+	}
+
+	// one PRD table with two regions, the first crossing a page boundary
+	void SetupPRD(uint16_t len0, uint16_t len1)
+	{
+		phys_writed(PRD_TABLE + 0, REGION0);
+		phys_writew(PRD_TABLE + 4, len0);
+		phys_writew(PRD_TABLE + 6, 0);
+		phys_writed(PRD_TABLE + 8, REGION1);
+		phys_writew(PRD_TABLE + 12, len1);
+		phys_writew(PRD_TABLE + 14, 0x8000); // end of table
+		IO_WriteD(bm_base + 4, PRD_TABLE);
+		IO_WriteB(bm_base + 2, BM_ST_ERROR | BM_ST_IRQ); // write 1 to clear
+	}
+
+	static PhysPt BufferAddr(Bitu ofs)
+	{
+		const Bitu half = (SECTORS * 512u) / 2u;
+		return ofs < half ? REGION0 + (PhysPt)ofs : REGION1 + (PhysPt)(ofs - half);
+	}
+
+	static void IssueLBA(uint8_t drive, uint8_t cmd, uint32_t lba, uint8_t count)
+	{
+		IO_WriteB(ATA_DRIVE, (Bitu)(drive | 0x40u | ((lba >> 24u) & 0xFu)));
+		IO_WriteB(ATA_COUNT, count);
+		IO_WriteB(ATA_LBA0, lba & 0xFFu);
+		IO_WriteB(ATA_LBA1, (lba >> 8u) & 0xFFu);
+		IO_WriteB(ATA_LBA2, (lba >> 16u) & 0xFFu);
+		IO_WriteB(ATA_CMD, cmd);
+	}
+
+	Section_prop *primary = nullptr;
+	Section_prop *secondary = nullptr;
+	bool saved_busmaster = false;
+	bool reinitialized = false;
+	unsigned bm_base = 0;
+	std::vector<uint8_t> saved_ram;
+	CALLBACK_HandlerObject irq;
+	int disk_index = -1;
+	imageDisk *disk = nullptr;
+	char cd_letter = 0;
+};
+
+TEST_F(IDEBusMasterTest, ReadDMAAcrossPageBoundary)
+{
+	AttachDisk();
+	for (PhysPt a = REGION0; a < SCRATCH_END; a++)
+		phys_writeb(a, 0xEE);
+	SetupPRD(0x800, 0x800);
+
+	const uint32_t lba = 5;
+	IssueLBA(0xA0, 0xC8, lba, SECTORS); // READ DMA
+	IO_WriteB(bm_base, BM_CMD_WRITE | BM_CMD_START);
+	ASSERT_TRUE(RunUntil([] { return ide_irq_count > 0 && NotBusy(); }));
+	RunUntil([] { return false; }, 1.0); // any stray interrupt would show up here
+
+	const uint8_t bm_status = (uint8_t)IO_ReadB(bm_base + 2);
+	IO_WriteB(bm_base, 0);
+	EXPECT_EQ(ide_irq_count, 1u);
+	EXPECT_EQ(bm_status & BM_ST_ACTIVE, 0);
+	EXPECT_EQ(bm_status & BM_ST_ERROR, 0);
+	EXPECT_EQ(bm_status & BM_ST_IRQ, BM_ST_IRQ);
+	EXPECT_EQ(IO_ReadB(ATA_CMD) & (ATA_ST_DRQ | ATA_ST_ERR), 0u);
+
+	for (Bitu i = 0; i < SECTORS * 512u; i++)
+		ASSERT_EQ(phys_readb(BufferAddr(i)), DiskPattern(lba + i / 512u, i % 512u)) << "offset " << i;
+}
+
+TEST_F(IDEBusMasterTest, WriteDMAAcrossPageBoundary)
+{
+	AttachDisk();
+	for (Bitu i = 0; i < SECTORS * 512u; i++)
+		phys_writeb(BufferAddr(i), (uint8_t)(i ^ 0x5A));
+	SetupPRD(0x800, 0x800);
+
+	const uint32_t lba = 40;
+	IssueLBA(0xA0, 0xCA, lba, SECTORS); // WRITE DMA
+	IO_WriteB(bm_base, BM_CMD_START);
+	ASSERT_TRUE(RunUntil([] { return ide_irq_count > 0 && NotBusy(); }));
+	RunUntil([] { return false; }, 1.0);
+
+	const uint8_t bm_status = (uint8_t)IO_ReadB(bm_base + 2);
+	IO_WriteB(bm_base, 0);
+	EXPECT_EQ(ide_irq_count, 1u);
+	EXPECT_EQ(bm_status & BM_ST_ACTIVE, 0);
+	EXPECT_EQ(bm_status & BM_ST_ERROR, 0);
+	EXPECT_EQ(bm_status & BM_ST_IRQ, BM_ST_IRQ);
+
+	std::vector<uint8_t> sector(512);
+	for (unsigned s = 0; s < SECTORS; s++) {
+		ASSERT_EQ(disk->Read_AbsoluteSector(lba + s, &sector[0]), 0);
+		for (Bitu i = 0; i < 512; i++)
+			ASSERT_EQ(sector[i], (uint8_t)((s * 512u + i) ^ 0x5A)) << "sector " << s << " offset " << i;
+	}
+	// the neighbours are untouched
+	ASSERT_EQ(disk->Read_AbsoluteSector(lba + SECTORS, &sector[0]), 0);
+	EXPECT_EQ(sector[0], DiskPattern(lba + SECTORS, 0));
+}
+
+TEST_F(IDEBusMasterTest, ATAPIPacketDMA)
+{
+	uint8_t subunit = 0;
+	const int r = MSCDEX_AddDrive('Y', "empty", subunit);
+	if (r != 0 && r != 5)
+		GTEST_SKIP() << "cannot add an MSCDEX drive (" << r << ")";
+	cd_letter = 'Y';
+	IDE_CDROM_Attach(0, true, (unsigned char)(cd_letter - 'A'));
+	ASSERT_TRUE(IDE_controller_occupied(0, true));
+
+	for (PhysPt a = REGION0; a < REGION0 + 64; a++)
+		phys_writeb(a, 0xEE);
+	// a single region that is just the INQUIRY response
+	phys_writed(PRD_TABLE + 0, REGION0);
+	phys_writew(PRD_TABLE + 4, 36);
+	phys_writew(PRD_TABLE + 6, 0x8000);
+	IO_WriteD(bm_base + 4, PRD_TABLE);
+	IO_WriteB(bm_base + 2, BM_ST_ERROR | BM_ST_IRQ);
+
+	IO_WriteB(ATA_DRIVE, 0xB0);
+	IO_WriteB(ATA_FEATURE, 0x01); // DMA
+	IO_WriteB(ATA_LBA1, 36);
+	IO_WriteB(ATA_LBA2, 0);
+	IO_WriteB(ATA_CMD, 0xA0); // PACKET
+	ASSERT_TRUE(RunUntil([] { return (IO_ReadB(0x3F6) & (ATA_ST_BSY | ATA_ST_DRQ)) == ATA_ST_DRQ; }));
+	EXPECT_EQ(ide_irq_count, 0u); // no interrupt for the command phase
+
+	const uint8_t packet[12] = { 0x12, 0, 0, 0, 36, 0, 0, 0, 0, 0, 0, 0 }; // INQUIRY
+	for (unsigned i = 0; i < 12; i += 2)
+		IO_WriteW(ATA_DATA, (Bitu)packet[i] | ((Bitu)packet[i + 1] << 8u));
+	IO_WriteB(bm_base, BM_CMD_WRITE | BM_CMD_START);
+	ASSERT_TRUE(RunUntil([] { return ide_irq_count > 0 && NotBusy(); }));
+	RunUntil([] { return false; }, 1.0);
+
+	const uint8_t bm_status = (uint8_t)IO_ReadB(bm_base + 2);
+	IO_WriteB(bm_base, 0);
+	EXPECT_EQ(ide_irq_count, 1u);
+	EXPECT_EQ(bm_status & BM_ST_ACTIVE, 0);
+	EXPECT_EQ(bm_status & BM_ST_ERROR, 0);
+	EXPECT_EQ(bm_status & BM_ST_IRQ, BM_ST_IRQ);
+
+	EXPECT_EQ(phys_readb(REGION0 + 0), 0x05);     // CD/DVD device
+	EXPECT_EQ(phys_readb(REGION0 + 1), 0x80);     // removable media
+	EXPECT_NE(phys_readb(REGION0 + 8), 0xEE);     // vendor string landed
+	EXPECT_EQ(phys_readb(REGION0 + 36), 0xEE);    // and nothing past the PRD region
+}
+
+// Not a pass/fail test: moves the same sectors by bus master DMA and by PIO through
+// port 1F0h, and reports the emulated and host time of each.
+TEST_F(IDEBusMasterTest, Benchmark_DMA_vs_PIO)
+{
+	AttachDisk();
+	const uint32_t lba = 100;
+	const int rounds = 50;
+
+	double dma_emu = 0, pio_emu = 0;
+	std::chrono::duration<double> dma_host(0), pio_host(0);
+
+	for (int r = 0; r < rounds; r++) {
+		SetupPRD(0x800, 0x800);
+		ide_irq_count = 0;
+		double t0 = PIC_FullIndex();
+		auto h0 = std::chrono::steady_clock::now();
+		IssueLBA(0xA0, 0xC8, lba, SECTORS);
+		IO_WriteB(bm_base, BM_CMD_WRITE | BM_CMD_START);
+		ASSERT_TRUE(RunUntil([] { return ide_irq_count > 0 && NotBusy(); }));
+		IO_WriteB(bm_base, 0);
+		dma_host += std::chrono::steady_clock::now() - h0;
+		dma_emu += PIC_FullIndex() - t0;
+
+		ide_irq_count = 0;
+		t0 = PIC_FullIndex();
+		h0 = std::chrono::steady_clock::now();
+		IssueLBA(0xA0, 0x20, lba, SECTORS); // READ SECTORS
+		for (unsigned s = 0; s < SECTORS; s++) {
+			ASSERT_TRUE(RunUntil([] { return (IO_ReadB(0x3F6) & (ATA_ST_BSY | ATA_ST_DRQ)) == ATA_ST_DRQ; }));
+			for (Bitu w = 0; w < 256; w++) {
+				const Bitu v = IO_ReadW(ATA_DATA);
+				const Bitu i = s * 512u + w * 2u;
+				ASSERT_EQ(v & 0xFFu, phys_readb(BufferAddr(i))) << "PIO and DMA disagree at " << i;
+			}
+		}
+		pio_host += std::chrono::steady_clock::now() - h0;
+		pio_emu += PIC_FullIndex() - t0;
+		RunUntil([] { return NotBusy(); });
+	}
+
+	printf("IDE read of %u sectors, average of %d: bus master DMA %.3f ms emulated, %.1f us host\n",
+	       SECTORS, rounds, dma_emu / rounds, dma_host.count() * 1e6 / rounds);
+	printf("IDE read of %u sectors, average of %d: PIO via 1F0h   %.3f ms emulated, %.1f us host\n",
+	       SECTORS, rounds, pio_emu / rounds, pio_host.count() * 1e6 / rounds);
+}
+
+} // namespace
@@ -0,0 +1,143 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "control.h"
+#include "logging.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+extern unsigned int log_ratelimit;
+
+namespace {
+
+class LoggingTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		saved_severity = loggrp[LOG_PCI].min_severity;
+		saved_ratelimit = log_ratelimit;
+		saved_nolog = control->opt_nolog;
+		control->opt_nolog = false; // -tests turns logging off
+
+		// catch what goes to the log file
+		LOG::Flush();
+		saved_debuglog = debuglog;
+		debuglog = tmpfile();
+		ASSERT_NE(debuglog, nullptr);
+	}
+
+	void TearDown() override
+	{
+		LOG::Flush();
+		if (debuglog != NULL && debuglog != saved_debuglog)
+			fclose(debuglog);
+		debuglog = saved_debuglog;
+		loggrp[LOG_PCI].min_severity = saved_severity;
+		log_ratelimit = saved_ratelimit;
+		control->opt_nolog = saved_nolog;
+	}
+
+	// lines written to the log file so far
+	static std::vector<std::string> Lines()
+	{
+		std::vector<std::string> lines;
+		char line[1024];
+
+		LOG::Flush();
+		rewind(debuglog);
+		while (fgets(line, sizeof(line), debuglog) != NULL) {
+			std::string str = line;
+			while (!str.empty() && str.back() == '\n')
+				str.pop_back();
+			lines.push_back(str);
+		}
+		fseek(debuglog, 0, SEEK_END);
+		return lines;
+	}
+
+	LOG_SEVERITIES saved_severity = LOG_NORMAL;
+	unsigned int saved_ratelimit = 0;
+	FILE* saved_debuglog = NULL;
+	bool saved_nolog = true;
+};
+
+TEST_F(LoggingTest, FiltersAndKeepsOrder)
+{
+	loggrp[LOG_PCI].min_severity = LOG_WARN;
+	LOG(LOG_PCI, LOG_NORMAL)("filtered %d", 1);
+	for (int i = 0; i < 100; i++)
+		LOG(LOG_PCI, LOG_WARN)("message %d %s", i, "text");
+
+	const std::vector<std::string> lines = Lines();
+	ASSERT_EQ(lines.size(), 100u);
+	for (int i = 0; i < 100; i++) {
+		const std::string expect = " WARN  PCI:message " + std::to_string(i) + " text";
+		ASSERT_EQ(lines[(size_t)i].substr(10), expect);
+	}
+}
+
+TEST_F(LoggingTest, RateLimitDropsAndCounts)
+{
+	loggrp[LOG_PCI].min_severity = LOG_NORMAL;
+	log_ratelimit = 10;
+
+	const unsigned int dropped = LOG::Dropped(LOG_PCI);
+	unsigned int sent = 0;
+	const auto start = std::chrono::steady_clock::now();
+	// stay within one second, or the limit starts over
+	while (sent < 50 && std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500)) {
+		LOG(LOG_PCI, LOG_NORMAL)("limited %u", sent);
+		sent++;
+	}
+
+	const std::vector<std::string> lines = Lines();
+	EXPECT_LE(lines.size(), 10u + 1u);
+	EXPECT_GE(LOG::Dropped(LOG_PCI) - dropped, sent - 10u - 1u);
+}
+
+TEST_F(LoggingTest, Benchmark_MessagesPerSecond)
+{
+	const int count = 500;
+
+	loggrp[LOG_PCI].min_severity = LOG_ERROR;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count * 100; i++)
+		LOG(LOG_PCI, LOG_NORMAL)("filtered %d %s", i, "text");
+	const double filtered = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	loggrp[LOG_PCI].min_severity = LOG_NORMAL;
+	const unsigned int dropped = LOG::Dropped(LOG_ALL);
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; i++)
+		LOG(LOG_PCI, LOG_NORMAL)("logged %d %s", i, "text");
+	const double logged = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	EXPECT_EQ(Lines().size() + (LOG::Dropped(LOG_ALL) - dropped), (size_t)count);
+	printf("logging: %8.2f M filtered messages/s, %8.3f M logged messages/s\n",
+	       count * 100 / (filtered + 1e-9) / 1e6, count / (logged + 1e-9) / 1e6);
+}
+
+} // namespace
@@ -0,0 +1,204 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include "dosbox.h"
+#include "mixer.h"
+
+#include <chrono>
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+namespace {
+
+void MixerTestHandler(Bitu len)
+{
+	(void)len;
+}
+
+class MixerKernelTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		chan = MIXER_AddChannel(MixerTestHandler, 22050, "MIXTEST");
+	}
+
+	void TearDown() override
+	{
+		MIXER_DelChannel(chan);
+	}
+
+	uint32_t Random()
+	{
+		seed = seed * 1103515245u + 12345u;
+		return (seed >> 16) | (seed << 16);
+	}
+
+	// full range 32-bit samples, with plenty of them near the clipping points
+	int32_t RandomSample()
+	{
+		switch (Random() % 4) {
+		case 0: return (int32_t)Random();
+		case 1: return (int32_t)(Random() % 0x10000000u) - 0x8000000;
+		case 2: return (int32_t)(((int64_t)(Random() % 4096) - 2048 + 32767) << 13);
+		default: return (int32_t)(((int64_t)(Random() % 4096) - 2048 - 32768) << 13);
+		}
+	}
+
+	// the filter before it became biquad sections, lowpass_order 16.16 fixed point one-pole stages
+	static void OnePoleCascade(int32_t ch[2], int32_t state[LOWPASS_ORDER][2], unsigned int order, int32_t alpha)
+	{
+		for (unsigned int i = 0; i < order; i++) {
+			for (unsigned int c = 0; c < 2; c++) {
+				const int64_t m1 = (int64_t)ch[c] * alpha;
+				const int64_t m2 = ((int64_t)state[i][c] << 16) - (int64_t)state[i][c] * alpha;
+				ch[c] = state[i][c] = (int32_t)((m1 + m2) >> 16);
+			}
+		}
+	}
+
+	MixerChannel* chan = nullptr;
+	uint32_t seed = 1;
+};
+
+TEST_F(MixerKernelTest, ScaleClipMatchesShiftAndClip)
+{
+	const int32_t volumes[] = { 0, 1 << 13, 3 << 11, 1 << 15, 12345 };
+	std::vector<int32_t> in(2 * 1001);
+	std::vector<int16_t> out(in.size());
+	for (auto &s : in)
+		s = RandomSample();
+	in[0] = std::numeric_limits<int32_t>::min();
+	in[1] = std::numeric_limits<int32_t>::max();
+
+	for (int32_t v1 : volumes) {
+		for (int32_t v2 : volumes) {
+			MIXER_ScaleClip(out.data(), in.data(), in.size() / 2, v1, v2);
+			for (size_t i = 0; i < in.size(); i++) {
+				const int64_t s = ((int64_t)in[i] * ((i & 1) ? v2 : v1)) >> 26;
+				const int16_t expect = (int16_t)(s < MIN_AUDIO ? MIN_AUDIO : s > MAX_AUDIO ? MAX_AUDIO : s);
+				ASSERT_EQ(out[i], expect) << "sample " << in[i] << " volume " << ((i & 1) ? v2 : v1);
+			}
+		}
+	}
+}
+
+TEST_F(MixerKernelTest, InterpolationDivideIsExact)
+{
+	for (Bitu den : { 1u, 3u, 100u, 44100u }) {
+		chan->SetFreq(22050 * den, den);
+		for (int n = 0; n < 200000; n++) {
+			int32_t d = (int32_t)Random();
+			if (n < 4) d = n < 2 ? std::numeric_limits<int32_t>::min() : std::numeric_limits<int32_t>::max();
+			else if (n & 1) d >>= Random() % 31;
+			const unsigned int f = (n & 2) ? chan->freq_d - 1u : Random() % chan->freq_d;
+			ASSERT_EQ(chan->scaleDelta(d, f), (int32_t)(((int64_t)d * (int64_t)f) / (int64_t)chan->freq_d))
+			        << d << " * " << f << " / " << chan->freq_d;
+		}
+	}
+}
+
+TEST_F(MixerKernelTest, LowpassTracksOnePoleCascade)
+{
+	for (unsigned int order : { 1u, 2u, 3u, 8u }) {
+		for (Bitu cutoff : { 3800u, 10000u, 23000u }) {
+			chan->SetLowpassFreq(0);
+			chan->SetLowpassFreq(cutoff, order);
+			memset(chan->lowpass, 0, sizeof(chan->lowpass));
+			int32_t state[LOWPASS_ORDER][2] = {};
+
+			int32_t max_error = 0;
+			for (int n = 0; n < 20000; n++) {
+				// sample * volume, the way the mixer filters its output, holding each level a while
+				int32_t in[2];
+				in[0] = (n % 7 == 0 ? (int32_t)(Random() % 65536u) - 32768 : 12000) << 13;
+				in[1] = (n & 64) ? (32767 << 13) : -(32768 << 13);
+				int32_t ref[2] = { in[0], in[1] };
+
+				chan->lowpassProc(in);
+				OnePoleCascade(ref, state, order, chan->lowpass_alpha);
+				for (unsigned int c = 0; c < 2; c++)
+					max_error = std::max(max_error, abs(in[c] - ref[c]));
+			}
+			// the old stages each rounded down, by less than one, which adds up in a stage's
+			// feedback to less than 1/alpha. Samples here are 16-bit ones times 8192.
+			const int32_t tolerance = (int32_t)(order * 0x10000u / (uint32_t)chan->lowpass_alpha) + 1;
+			EXPECT_LE(max_error, tolerance) << "order " << order << " cutoff " << cutoff;
+		}
+	}
+}
+
+TEST_F(MixerKernelTest, Benchmark_Kernels)
+{
+	const size_t frames = 1024;
+	const unsigned int rounds = 20000;
+	std::vector<int32_t> in(2 * frames);
+	std::vector<int16_t> out(in.size());
+	for (auto &s : in)
+		s = RandomSample();
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < rounds; r++)
+		MIXER_ScaleClip(out.data(), in.data(), frames, 1 << 13, 3 << 11);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("mixer %-16s: %8.2f M frames/s\n", "volume and clip", frames * rounds / seconds / 1e6);
+
+	chan->SetLowpassFreq(3800, 8);
+	start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < rounds / 10; r++) {
+		for (size_t i = 0; i < frames; i++)
+			chan->lowpassProc(&in[i * 2]);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("mixer %-16s: %8.2f M frames/s\n", "order 8 lowpass", frames * (rounds / 10) / seconds / 1e6);
+
+	int32_t state[LOWPASS_ORDER][2] = {};
+	start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < rounds / 10; r++) {
+		for (size_t i = 0; i < frames; i++)
+			OnePoleCascade(&in[i * 2], state, 8, chan->lowpass_alpha);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("mixer %-16s: %8.2f M frames/s\n", "8 one-pole", frames * (rounds / 10) / seconds / 1e6);
+
+	int64_t sum = 0;
+	start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < rounds / 10; r++) {
+		for (size_t i = 0; i < frames; i++)
+			sum += chan->scaleDelta(in[i * 2], (unsigned int)i % chan->freq_d);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("mixer %-16s: %8.2f M samples/s\n", "interpolation", frames * (rounds / 10) / seconds / 1e6);
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < rounds / 10; r++) {
+		for (size_t i = 0; i < frames; i++)
+			sum -= (int32_t)(((int64_t)in[i * 2] * (int64_t)(i % chan->freq_d)) / (int64_t)chan->freq_d);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("mixer %-16s: %8.2f M samples/s\n", "64-bit divide", frames * (rounds / 10) / seconds / 1e6);
+	EXPECT_EQ(sum, 0);
+}
+
+} // namespace
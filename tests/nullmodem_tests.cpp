@@ -0,0 +1,196 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "callback.h"
+#include "inout.h"
+#include "pic.h"
+#include "serialport.h"
+
+#if C_MODEM
+#include "../src/hardware/serialport/misc_util.h"
+#endif
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+void runSerial(const char *str);
+
+namespace {
+
+#if C_MODEM
+
+// COM4 is a nullmodem client of a server socket owned by the test
+const uint16_t COM4_BASE = 0x2E8;
+const uint16_t TEST_PORT = 23571;
+
+class NullModemTest : public DOSBoxTestFixture {
+public:
+	void TearDown() override
+	{
+		runSerial("4 disabled");
+		delete peer;
+		peer = nullptr;
+	}
+
+	// Connect COM4 to the test and program the UART: 8N1, FIFO on, DTR and RTS on
+	bool Connect(bool unthrottled, uint16_t divider)
+	{
+		NETServerSocket* server = NETServerSocket::NETServerFactory(SOCKET_TYPE_TCP, TEST_PORT);
+		if (!server->isopen) {
+			delete server;
+			return false;
+		}
+
+		char cmd[128];
+		sprintf(cmd, "4 nullmodem server:127.0.0.1 port:%u transparent:1 unthrottled:%u", TEST_PORT,
+		        unthrottled ? 1u : 0u);
+		runSerial(cmd);
+		peer = server->Accept();
+		delete server;
+		if (peer == nullptr || serialports[3] == nullptr)
+			return false;
+
+		IO_WriteB(COM4_BASE + 3, 0x80);
+		IO_WriteB(COM4_BASE + 0, (uint8_t)divider);
+		IO_WriteB(COM4_BASE + 1, (uint8_t)(divider >> 8));
+		IO_WriteB(COM4_BASE + 3, 0x03);
+		IO_WriteB(COM4_BASE + 2, 0xC7);
+		IO_WriteB(COM4_BASE + 4, 0x03);
+		return true;
+	}
+
+	static uint8_t Pattern(size_t i)
+	{
+		return (uint8_t)(i * 7 + (i >> 8));
+	}
+
+	// Send count bytes from the test to COM4, and read them the way a polling program
+	// would. Returns the emulated milliseconds it took, or 0 if the data was wrong.
+	double Receive(size_t count)
+	{
+		std::vector<uint8_t> data(count);
+		for (size_t i = 0; i < count; i++)
+			data[i] = Pattern(i);
+		if (!peer->SendArray(data.data(), data.size()))
+			return 0;
+
+		const double start = PIC_FullIndex();
+		size_t received = 0;
+		while (received < count && PIC_FullIndex() < start + 10000.0) {
+			while (received < count && (IO_ReadB(COM4_BASE + 5) & 0x01)) {
+				if (IO_ReadB(COM4_BASE) != Pattern(received))
+					return 0;
+				received++;
+			}
+			CALLBACK_Idle();
+		}
+		return received == count ? PIC_FullIndex() - start : 0;
+	}
+
+	// Write count bytes to COM4 whenever the transmitter has room. Returns the emulated
+	// milliseconds until the test has them all, or 0 if the data was wrong.
+	double Transmit(size_t count)
+	{
+		std::vector<uint8_t> data(count);
+		const double start = PIC_FullIndex();
+		size_t written = 0, received = 0;
+		while (received < count && PIC_FullIndex() < start + 10000.0) {
+			if (written < count && (IO_ReadB(COM4_BASE + 5) & 0x20)) {
+				// the transmit FIFO is empty, fill it
+				for (unsigned int i = 0; i < 16 && written < count; i++, written++)
+					IO_WriteB(COM4_BASE, Pattern(written));
+			}
+			CALLBACK_Idle();
+
+			size_t n = data.size() - received;
+			if (!peer->ReceiveArray(data.data() + received, n))
+				return 0;
+			received += n;
+		}
+		for (size_t i = 0; i < count; i++) {
+			if (data[i] != Pattern(i))
+				return 0;
+		}
+		return received == count ? PIC_FullIndex() - start : 0;
+	}
+
+	NETClientSocket* peer = nullptr;
+};
+
+TEST_F(NullModemTest, ThrottledFollowsTheBaudRate)
+{
+	if (!Connect(false, 1))
+		GTEST_SKIP() << "cannot listen on port " << TEST_PORT;
+
+	// 115200 baud, 10 bits per byte: 2048 bytes take 178ms on the wire. The receiver
+	// catches up at 0.65 byte times per byte after the program has kept it waiting.
+	const double ms = Receive(2048);
+	ASSERT_GT(ms, 0.0);
+	EXPECT_GT(ms, 2048 * 0.65 * 10000.0 / 115200.0);
+	EXPECT_GT(Transmit(2048), 170.0);
+}
+
+TEST_F(NullModemTest, UnthrottledIgnoresTheBaudRate)
+{
+	if (!Connect(true, 12))
+		GTEST_SKIP() << "cannot listen on port " << TEST_PORT;
+
+	// 9600 baud would take over two seconds
+	const double ms = Receive(2048);
+	ASSERT_GT(ms, 0.0);
+	EXPECT_LT(ms, 100.0);
+
+	const double tx = Transmit(2048);
+	ASSERT_GT(tx, 0.0);
+	EXPECT_LT(tx, 100.0);
+}
+
+TEST_F(NullModemTest, Benchmark_Throughput)
+{
+	for (unsigned int unthrottled = 0; unthrottled < 2; unthrottled++) {
+		if (!Connect(unthrottled != 0, 1))
+			GTEST_SKIP() << "cannot listen on port " << TEST_PORT;
+
+		const size_t count = unthrottled ? 262144 : 16384;
+		const auto start = std::chrono::steady_clock::now();
+		const double rx = Receive(count);
+		const double tx = Transmit(count);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		ASSERT_GT(rx, 0.0);
+		ASSERT_GT(tx, 0.0);
+
+		printf("%-11s: receive %8.1f KB/s, transmit %8.1f KB/s emulated, %8.1f KB/s host\n",
+		       unthrottled ? "unthrottled" : "115200 baud", count / rx, count / tx,
+		       2.0 * count / 1000.0 / seconds);
+
+		runSerial("4 disabled");
+		delete peer;
+		peer = nullptr;
+	}
+}
+
+#endif // C_MODEM
+
+} // namespace
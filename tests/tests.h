@@ -21,10 +21,23 @@
 
 // The following are source files containing unit tests.
 
+#include "benchmark_tests.cpp"
+#include "cpu_cores_tests.cpp"
+#include "debug_breakpoint_tests.cpp"
+#include "debug_cputrace_tests.cpp"
+#include "dev_con_tests.cpp"
 #include "dos_files_tests.cpp"
 #include "drives_tests.cpp"
+#include "ethernet_tests.cpp"
+#include "gus_tests.cpp"
+#include "ide_busmaster_tests.cpp"
+#include "logging_tests.cpp"
+#include "mixer_tests.cpp"
+#include "nullmodem_tests.cpp"
 #include "shell_cmds_tests.cpp"
 #include "shell_redirection_tests.cpp"
+#include "vga_dirty_tests.cpp"
+#include "vga_xga_tests.cpp"
 
 #else
 //google test code causes problem on win9x, remove them and add empty implementations for linkage.
@@ -0,0 +1,177 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "callback.h"
+#include "inout.h"
+#include "mem.h"
+#include "paging.h"
+#include "pic.h"
+#include "render.h"
+#include "vga.h"
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+bool INT10_SetVideoMode(uint16_t mode);
+
+namespace {
+
+// VESA 640x480 256 colors, one byte per pixel, 640 bytes per scanline
+const uint16_t TEST_MODE = 0x101;
+const unsigned TEST_WIDTH = 640;
+const unsigned TEST_HEIGHT = 480;
+
+class VGA_DirtyTest : public DOSBoxTestFixture {
+public:
+	void SetUp() override
+	{
+		if (svgaCard != SVGA_S3Trio || vga_dirty.pages == NULL)
+			GTEST_SKIP() << "needs an S3 card";
+
+		saved_mode = real_readb(0x40, 0x49); // BIOS current video mode
+		saved_tracking = vga_dirty_tracking;
+		saved_curmode = vga.s3.hgc.curmode;
+
+		vga_dirty_tracking = true;
+		ASSERT_TRUE(INT10_SetVideoMode(TEST_MODE));
+		mode_set = true;
+
+		if (!Settle(0))
+			GTEST_SKIP() << "renderer does not keep a scanline cache here";
+	}
+
+	void TearDown() override
+	{
+		if (!mode_set)
+			return;
+
+		vga.s3.hgc.curmode = saved_curmode;
+		VGA_ActivateHardwareCursor();
+		vga_dirty_tracking = saved_tracking;
+		INT10_SetVideoMode(saved_mode);
+		PAGING_ClearTLB();
+	}
+
+	// wait for the start of vertical retrace. every visible line of the frame has been
+	// drawn by then, and the next frame has not started.
+	static void WaitRetrace()
+	{
+		const double end = PIC_FullIndex() + 100.0;
+		while ((IO_ReadB(0x3DA) & 8) && PIC_FullIndex() < end)
+			CALLBACK_Idle();
+		while (!(IO_ReadB(0x3DA) & 8) && PIC_FullIndex() < end)
+			CALLBACK_Idle();
+	}
+
+	// scanlines converted from video memory in the next complete frame
+	static unsigned NextFrameConverted()
+	{
+		WaitRetrace();
+		return vga_dirty.lines_converted;
+	}
+
+	// run frames until a frame converts no more than expected scanlines
+	static bool Settle(unsigned expected)
+	{
+		for (int i = 0; i < 20; i++) {
+			if (NextFrameConverted() <= expected)
+				return true;
+		}
+		return false;
+	}
+
+	void ShowCursor(uint16_t y)
+	{
+		vga.s3.hgc.originx = 100;
+		vga.s3.hgc.originy = y;
+		vga.s3.hgc.posx = 0;
+		vga.s3.hgc.posy = 0;
+		vga.s3.hgc.startaddr = 0x180; // pattern at 384KB, past the visible screen
+		if (!(vga.s3.hgc.curmode & 1)) {
+			vga.s3.hgc.curmode |= 1;
+			VGA_ActivateHardwareCursor();
+		}
+	}
+
+	uint16_t saved_mode = 3;
+	bool saved_tracking = false;
+	uint8_t saved_curmode = 0;
+	bool mode_set = false;
+};
+
+TEST_F(VGA_DirtyTest, StaticScreenConvertsNothing)
+{
+	EXPECT_EQ(NextFrameConverted(), 0u);
+	EXPECT_EQ(NextFrameConverted(), 0u);
+}
+
+TEST_F(VGA_DirtyTest, PageWriteReconvertsOnlyItsScanlines)
+{
+	WaitRetrace();
+	mem_writeb(0xA3000, 0x55); // window at A0000h, bank 0: VRAM page 3 (bytes 3000h-3FFFh)
+
+	// scanlines 19 (3000h is within 12160..12799) through 25 (16000..16639) read page 3
+	const unsigned first = 0x3000u / TEST_WIDTH;
+	const unsigned last = 0x3FFFu / TEST_WIDTH;
+	EXPECT_EQ(NextFrameConverted(), last - first + 1u);
+	EXPECT_EQ(NextFrameConverted(), 0u);
+
+	// a write that touches two pages converts the lines of both
+	WaitRetrace();
+	mem_writew(0xA4FFF, 0x1234);
+	EXPECT_EQ(NextFrameConverted(), (0x5FFFu / TEST_WIDTH) - (0x4000u / TEST_WIDTH) + 1u);
+	EXPECT_EQ(NextFrameConverted(), 0u);
+}
+
+TEST_F(VGA_DirtyTest, PaletteChangeReconvertsWholeFrame)
+{
+	WaitRetrace();
+	IO_WriteB(0x3C8, 7);
+	IO_WriteB(0x3C9, 0x3F);
+	IO_WriteB(0x3C9, 0x00);
+	IO_WriteB(0x3C9, 0x20);
+
+	EXPECT_EQ(NextFrameConverted(), TEST_HEIGHT);
+	EXPECT_EQ(NextFrameConverted(), 0u);
+}
+
+TEST_F(VGA_DirtyTest, HardwareCursorLinesAreConverted)
+{
+	ShowCursor(100);
+	ASSERT_TRUE(Settle(64));
+	EXPECT_EQ(NextFrameConverted(), 64u);
+
+	// moving the cursor converts the lines it left, once
+	WaitRetrace();
+	vga.s3.hgc.originy = 300;
+	EXPECT_EQ(NextFrameConverted(), 128u);
+	EXPECT_EQ(NextFrameConverted(), 64u);
+
+	// and so does hiding it
+	WaitRetrace();
+	vga.s3.hgc.posx = 63;
+	vga.s3.hgc.originx = 0;
+	vga.s3.hgc.curmode &= ~1u;
+	VGA_ActivateHardwareCursor();
+	EXPECT_EQ(NextFrameConverted(), TEST_HEIGHT); // the line handler changed
+	EXPECT_EQ(NextFrameConverted(), 0u);
+}
+
+} // namespace
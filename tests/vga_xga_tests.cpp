@@ -0,0 +1,312 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "vga.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dosbox_test_fixture.h"
+
+void XGA_Write(Bitu port, Bitu val, Bitu len);
+extern bool xga_span_disable;
+extern Bitu xga_span_commands;
+
+namespace {
+
+// S3 drawing commands as written to port 9AE8h: draw (bit 4), pixel write (bit 0),
+// X positive (bit 5), Y positive (bit 7)
+const Bitu XGA_CMD_RECT_FILL = 0x40B1;
+const Bitu XGA_CMD_BITBLT    = 0xC0B1;
+const Bitu XGA_CMD_PATTERN   = 0xE0B1;
+
+const Bitu XGA_MIX_SRC_FG    = 0x27; // foreground color, SRC
+const Bitu XGA_MIX_BITMAP    = 0x67; // video memory, SRC
+const Bitu XGA_MIX_FG_XOR    = 0x25; // foreground color, SRC xor DST
+const Bitu XGA_MIX_NOT_DST   = 0x20;
+
+class XGA_SpanTest : public DOSBoxTestFixture {
+public:
+	static const Bitu pitch = 1024;
+	static const Bitu lines = 768;
+
+	void SetUp() override
+	{
+		saved_linear = vga.mem.linear;
+		saved_memsize = vga.mem.memsize;
+		saved_memmask = vga.mem.memmask;
+		saved_width = vga.s3.xga_screen_width;
+		saved_mode = vga.s3.xga_color_mode;
+		saved_tracking = vga_dirty_tracking;
+
+		vram.assign(pitch * lines * 4, 0);
+		vga.mem.linear = &vram[0];
+		vga.mem.memsize = (uint32_t)vram.size();
+		vga.mem.memmask = vga.mem.memsize - 1u;
+		vga.s3.xga_screen_width = pitch;
+		vga_dirty_tracking = false;
+		xga_span_disable = false;
+	}
+
+	void TearDown() override
+	{
+		vga.mem.linear = saved_linear;
+		vga.mem.memsize = saved_memsize;
+		vga.mem.memmask = saved_memmask;
+		vga.s3.xga_screen_width = saved_width;
+		vga.s3.xga_color_mode = saved_mode;
+		vga_dirty_tracking = saved_tracking;
+		xga_span_disable = false;
+	}
+
+	void SetMode(VGAModes mode)
+	{
+		vga.s3.xga_color_mode = mode;
+		XGA_Write(0xbee8, 0xE200, 2); // 32-bit register access for M_LIN32
+		XGA_Write(0xbee8, 0xA000, 2); // foreground mix always
+		XGA_Write(0xbee8, 0x1000, 2); // scissors cover the whole surface
+		XGA_Write(0xbee8, 0x2000, 2);
+		XGA_Write(0xbee8, 0x3000 | (lines - 1), 2);
+		XGA_Write(0xbee8, 0x4000 | (pitch - 1), 2);
+		XGA_Write(0xaae8, 0xFFFFFFFF, 4);
+	}
+
+	void Command(Bitu cmd, Bitu mix, uint32_t color, Bitu sx, Bitu sy,
+	             Bitu dx, Bitu dy, Bitu w, Bitu h)
+	{
+		XGA_Write(0xbae8, mix, 2);
+		XGA_Write(0xa6e8, color, 4);
+		XGA_Write(0x86e8, sx, 2);
+		XGA_Write(0x82e8, sy, 2);
+		XGA_Write(0x8ee8, dx, 2);
+		XGA_Write(0x8ae8, dy, 2);
+		XGA_Write(0x96e8, w - 1, 2);
+		XGA_Write(0xbee8, 0x0000 | (h - 1), 2);
+		XGA_Write(0x9ae8, cmd, 2);
+	}
+
+	uint8_t &Pixel8(Bitu x, Bitu y) { return vram[y * pitch + x]; }
+	uint16_t &Pixel16(Bitu x, Bitu y) { return ((uint16_t *)&vram[0])[y * pitch + x]; }
+	uint32_t &Pixel32(Bitu x, Bitu y) { return ((uint32_t *)&vram[0])[y * pitch + x]; }
+
+	void Scribble()
+	{
+		for (size_t i = 0; i < vram.size(); i++)
+			vram[i] = (uint8_t)((i * 7u) ^ (i >> 9u));
+	}
+
+	std::vector<uint8_t> vram;
+
+private:
+	uint8_t *saved_linear = NULL;
+	uint32_t saved_memsize = 0;
+	uint32_t saved_memmask = 0;
+	Bitu saved_width = 0;
+	VGAModes saved_mode = M_LIN8;
+	bool saved_tracking = false;
+};
+
+TEST_F(XGA_SpanTest, RectFill_8bpp_Clipped)
+{
+	SetMode(M_LIN8);
+	XGA_Write(0xbee8, 0x2000 | 20, 2); // left scissor
+	Command(XGA_CMD_RECT_FILL, XGA_MIX_SRC_FG, 0x5A, 10, 5, 0, 0, 30, 4);
+
+	EXPECT_EQ(Pixel8(19, 5), 0);
+	EXPECT_EQ(Pixel8(20, 5), 0x5A);
+	EXPECT_EQ(Pixel8(39, 8), 0x5A);
+	EXPECT_EQ(Pixel8(40, 8), 0);
+	EXPECT_EQ(Pixel8(25, 9), 0);
+}
+
+TEST_F(XGA_SpanTest, RectFill_16bpp_XorAndNot)
+{
+	SetMode(M_LIN16);
+	Scribble();
+	const uint16_t before = Pixel16(100, 50);
+	Command(XGA_CMD_RECT_FILL, XGA_MIX_FG_XOR, 0xF00F, 100, 50, 0, 0, 8, 8);
+	EXPECT_EQ(Pixel16(100, 50), (uint16_t)(before ^ 0xF00F));
+	Command(XGA_CMD_RECT_FILL, XGA_MIX_NOT_DST, 0, 100, 50, 0, 0, 8, 8);
+	EXPECT_EQ(Pixel16(100, 50), (uint16_t)~(before ^ 0xF00F));
+}
+
+TEST_F(XGA_SpanTest, RectFill_15bpp_MasksTopBit)
+{
+	SetMode(M_LIN15);
+	Command(XGA_CMD_RECT_FILL, XGA_MIX_SRC_FG, 0xFFFF, 0, 0, 0, 0, 4, 1);
+	EXPECT_EQ(Pixel16(3, 0), 0x7FFF);
+}
+
+TEST_F(XGA_SpanTest, BitBlt_32bpp_OverlappingScroll)
+{
+	SetMode(M_LIN32);
+	for (Bitu x = 0; x < 64; x++)
+		Pixel32(x, 10) = (uint32_t)(0x01000000u * x + x);
+
+	// scroll right by 3 pixels within the same row, walking right to left
+	Command(XGA_CMD_BITBLT & ~0x20u, XGA_MIX_BITMAP, 0, 40, 10, 43, 10, 41, 1);
+	for (Bitu x = 3; x <= 43; x++)
+		EXPECT_EQ(Pixel32(x, 10), (uint32_t)(0x01000000u * (x - 3) + (x - 3)));
+	EXPECT_EQ(Pixel32(2, 10), (uint32_t)(0x01000000u * 2 + 2));
+}
+
+TEST_F(XGA_SpanTest, BitBlt_8bpp_WrongDirectionSmears)
+{
+	SetMode(M_LIN8);
+	for (Bitu x = 0; x < 16; x++)
+		Pixel8(x, 0) = (uint8_t)(x + 1);
+
+	// walking left to right over its own source repeats the first pixels, as the per-pixel engine does
+	Command(XGA_CMD_BITBLT, XGA_MIX_BITMAP, 0, 0, 0, 2, 0, 8, 1);
+	const uint8_t expect[10] = { 1, 2, 1, 2, 1, 2, 1, 2, 1, 2 };
+	for (Bitu x = 0; x < 10; x++)
+		EXPECT_EQ(Pixel8(x, 0), expect[x]);
+}
+
+TEST_F(XGA_SpanTest, PatternFill_8bpp)
+{
+	SetMode(M_LIN8);
+	for (Bitu y = 0; y < 8; y++)
+		for (Bitu x = 0; x < 8; x++)
+			Pixel8(512 + x, 700 + y) = (uint8_t)(y * 8 + x);
+
+	Command(XGA_CMD_PATTERN, XGA_MIX_BITMAP, 0, 512, 700, 3, 5, 20, 10);
+	for (Bitu y = 5; y < 15; y++)
+		for (Bitu x = 3; x < 23; x++)
+			EXPECT_EQ(Pixel8(x, y), (uint8_t)((y & 7) * 8 + (x & 7)));
+}
+
+// Every mix and pixel size the span paths accept, run once through them and once through the
+// per-pixel path. Video memory must come out identical.
+TEST_F(XGA_SpanTest, SpansMatchPerPixelPath)
+{
+	static const VGAModes modes[4] = { M_LIN8, M_LIN15, M_LIN16, M_LIN32 };
+	static const Bitu mixes[5] = { 0x00, 0x01, 0x02, 0x05, 0x07 };
+	static const Bitu sources[3] = { 0x00, 0x20, 0x60 }; // background color, foreground color, video memory
+
+	struct Op {
+		const char *name;
+		Bitu cmd, sx, sy, dx, dy, w, h;
+		unsigned int sources; // rectangle fill with a video memory source is left to the per-pixel path
+	};
+	static const Op ops[] = {
+		{ "fill",          XGA_CMD_RECT_FILL,          0,   0,   0,   0, 300, 40, 2 },
+		{ "fill up-left",  XGA_CMD_RECT_FILL & ~0xA0u, 500, 300, 0,   0, 57,  33, 2 },
+		{ "blit",          XGA_CMD_BITBLT,             3,   100, 200, 150, 301, 47, 3 },
+		{ "blit up-left",  XGA_CMD_BITBLT & ~0xA0u,    700, 400, 650, 380, 129, 61, 3 },
+		{ "blit scroll",   XGA_CMD_BITBLT & ~0x20u,    40,  10,  43,  10, 41,  9, 3 },
+		{ "pattern",       XGA_CMD_PATTERN,            512, 700, 5,   3,  333, 29, 3 },
+		{ "pattern up",    XGA_CMD_PATTERN & ~0x80u,   512, 700, 100, 300, 17, 44, 3 },
+	};
+
+	Scribble();
+	const std::vector<uint8_t> scribbled = vram;
+	std::vector<uint8_t> expect;
+	unsigned int checked = 0;
+
+	for (unsigned int m = 0; m < 4; m++) {
+		for (const Op &op : ops) {
+			for (unsigned int src = 0; src < op.sources; src++) {
+				for (unsigned int mx = 0; mx < 5; mx++) {
+					const Bitu mix = sources[src] | mixes[mx];
+					SCOPED_TRACE(testing::Message() << op.name << " mode " << modes[m] << " mix " << std::hex << mix);
+
+					const Bitu spans_before = xga_span_commands;
+					for (int path = 0; path < 2; path++) {
+						SetMode(modes[m]);
+						XGA_Write(0xbee8, 0x2000 | 7, 2); // left scissor inside some of the rectangles
+						XGA_Write(0xa2e8, 0x00C3A55A, 4); // background color
+						std::copy(scribbled.begin(), scribbled.end(), vram.begin()); // keeps vga.mem.linear valid
+						xga_span_disable = (path == 1);
+						Command(op.cmd, mix, 0x8001F00Fu, op.sx, op.sy, op.dx, op.dy, op.w, op.h);
+						if (path == 0)
+							expect = vram;
+					}
+					xga_span_disable = false;
+
+					EXPECT_EQ(xga_span_commands - spans_before, 1u) << "span path not taken";
+					ASSERT_TRUE(vram == expect);
+					checked++;
+				}
+			}
+		}
+	}
+
+	EXPECT_EQ(checked, 4u * (2u * 2u + 5u * 3u) * 5u);
+}
+
+// Rough throughput of the GDI operations Windows S3 drivers issue most, reported as megapixels per
+// second for the span paths and the per-pixel path.
+TEST_F(XGA_SpanTest, Benchmark_GDI_Patterns)
+{
+	static const VGAModes modes[3] = { M_LIN8, M_LIN16, M_LIN32 };
+	static const char *names[3] = { "8bpp", "16bpp", "32bpp" };
+
+	for (unsigned int m = 0; m < 3; m++) {
+	for (int path = 0; path < 2; path++) {
+		SetMode(modes[m]);
+		Scribble();
+		xga_span_disable = (path == 1);
+
+		const int rounds = path ? 2 : 20;
+		double pixels[4] = { 0, 0, 0, 0 };
+		double seconds[4] = { 0, 0, 0, 0 };
+
+		for (unsigned int op = 0; op < 4; op++) {
+			const auto start = std::chrono::steady_clock::now();
+			for (int r = 0; r < rounds; r++) {
+				switch (op) {
+				case 0: // desktop background fill
+					Command(XGA_CMD_RECT_FILL, XGA_MIX_SRC_FG, 0x1234, 0, 0, 0, 0, 1024, 700);
+					pixels[op] += 1024.0 * 700.0;
+					break;
+				case 1: // window scroll
+					Command(XGA_CMD_BITBLT, XGA_MIX_BITMAP, 0, 0, 16, 0, 0, 1024, 680);
+					pixels[op] += 1024.0 * 680.0;
+					break;
+				case 2: // dithered brush
+					Command(XGA_CMD_PATTERN, XGA_MIX_BITMAP, 0, 0, 760, 0, 0, 1024, 700);
+					pixels[op] += 1024.0 * 700.0;
+					break;
+				default: // drag rectangle outline
+					for (int i = 0; i < 50; i++) {
+						Command(XGA_CMD_RECT_FILL, XGA_MIX_FG_XOR, 0xFFFF, 100, 100 + i, 0, 0, 600, 1);
+						Command(XGA_CMD_RECT_FILL, XGA_MIX_FG_XOR, 0xFFFF, 100 + i, 100, 0, 0, 1, 400);
+					}
+					pixels[op] += 50.0 * (600.0 + 400.0);
+					break;
+				}
+			}
+			seconds[op] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		printf("XGA %-5s %-9s fill %8.1f  blit %8.1f  pattern %8.1f  xor %8.1f Mpixel/s\n", names[m],
+		       path ? "per-pixel" : "spans",
+		       pixels[0] / (seconds[0] * 1e6 + 1e-9), pixels[1] / (seconds[1] * 1e6 + 1e-9),
+		       pixels[2] / (seconds[2] * 1e6 + 1e-9), pixels[3] / (seconds[3] * 1e6 + 1e-9));
+	}
+	}
+}
+
+} // namespace